@@ -0,0 +1,418 @@
+/*
+  Copyright (c) 2009-2019, Hideyuki Tanaka, Joel
+  All rights reserved.
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+  * Neither the name of the <organization> nor the
+  names of its contributors may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+  THIS SOFTWARE IS PROVIDED BY <copyright holder> ''AS IS'' AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Benchmarks for the parser hot paths.
+//
+// Builds synthetic schemas of 10 to 10,000 options and argv vectors of up to
+// millions of tokens, then reports ns/op, ns/arg, allocations per operation
+// (through a counting operator new) and peak RSS as JSON.
+//
+// Build with -DBUILD_BENCHMARKS=ON -DCMAKE_BUILD_TYPE=Release.
+
+#include <cmdline/cmdline.hpp>
+#include <cmdline/batch.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    std::atomic<unsigned long long> allocations(0);
+}
+
+void *operator new(std::size_t n)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t n)
+{
+    return ::operator new(n);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+    long peak_rss_kb()
+    {
+#if defined(_WIN32)
+        return 0;
+#else
+        rusage ru;
+        if (getrusage(RUSAGE_SELF, &ru) != 0)
+            return 0;
+#if defined(__APPLE__)
+        return ru.ru_maxrss / 1024;
+#else
+        return ru.ru_maxrss;
+#endif
+#endif
+    }
+
+    struct result
+    {
+        std::string name;
+        size_t options;
+        size_t args;
+        unsigned threads;
+        unsigned long long iterations;
+        double ns_per_op;
+        double ns_per_arg;
+        double allocs_per_op;
+        long peak_rss_kb;
+        bool ok;
+    };
+
+    // runs f until at least min_time seconds have elapsed
+    template <class F>
+    result measure(const std::string &name, size_t options, size_t args, double min_time, F f)
+    {
+        typedef std::chrono::steady_clock clock;
+
+        bool ok = f();
+
+        unsigned long long iterations = 0;
+        unsigned long long allocs_before = allocations.load();
+        clock::time_point start = clock::now();
+        clock::duration elapsed;
+        do {
+            f();
+            ++iterations;
+            elapsed = clock::now() - start;
+        } while (std::chrono::duration<double>(elapsed).count() < min_time);
+        unsigned long long allocs = allocations.load() - allocs_before;
+
+        double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+
+        result r;
+        r.name = name;
+        r.options = options;
+        r.args = args;
+        r.threads = 1;
+        r.iterations = iterations;
+        r.ns_per_op = ns;
+        r.ns_per_arg = args ? ns / args : 0;
+        r.allocs_per_op = static_cast<double>(allocs) / iterations;
+        r.peak_rss_kb = peak_rss_kb();
+        r.ok = ok;
+        return r;
+    }
+
+    enum kind { int_option, string_option, double_option, flag_option, kinds };
+
+    kind kind_of(size_t i) { return static_cast<kind>(i % kinds); }
+
+    std::string option_name(size_t i) { return "option-" + std::to_string(i); }
+
+    char short_name_of(size_t i)
+    {
+        static const char names[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+        return i < sizeof(names) - 1 ? names[i] : '\0';
+    }
+
+    std::vector<cmdline::option_ref<int> > build_schema(cmdline::parser &p, size_t options)
+    {
+        std::vector<cmdline::option_ref<int> > ints;
+        for (size_t i = 0; i < options; i++)
+        {
+            std::string name = option_name(i);
+            switch (kind_of(i))
+            {
+                case int_option:
+                    ints.push_back(p.add<int>(name, short_name_of(i), "integer option", false, 0));
+                    break;
+                case string_option:
+                    p.add<std::string>(name, short_name_of(i), "string option", false, "");
+                    break;
+                case double_option:
+                    p.add<double>(name, short_name_of(i), "floating point option", false, 0.0);
+                    break;
+                default:
+                    p.add(name, short_name_of(i), "flag option");
+                    break;
+            }
+        }
+        return ints;
+    }
+
+    // a mix of --name=value, --name value, -x value, flags and positionals
+    std::vector<std::string> build_args(size_t options, size_t args)
+    {
+        std::vector<std::string> ret;
+        ret.reserve(args + 1);
+        ret.push_back("cmdline_benchmark");
+        for (size_t i = 0; ret.size() <= args; i++)
+        {
+            if (i % 4 == 3) {
+                ret.push_back("input-" + std::to_string(i) + ".dat");
+                continue;
+            }
+
+            size_t o = (i * 7919) % options;
+            switch (kind_of(o))
+            {
+                case int_option:
+                    ret.push_back("--" + option_name(o) + "=" + std::to_string(i % 65536));
+                    break;
+                case string_option:
+                    if (short_name_of(o))
+                        ret.push_back(std::string("-") + short_name_of(o));
+                    else
+                        ret.push_back("--" + option_name(o));
+                    if (ret.size() <= args)
+                        ret.push_back("value-" + std::to_string(i));
+                    else
+                        ret.pop_back();
+                    break;
+                case double_option:
+                    ret.push_back("--" + option_name(o) + "=" + std::to_string(i) + ".25");
+                    break;
+                default:
+                    ret.push_back("--" + option_name(o));
+                    break;
+            }
+        }
+        return ret;
+    }
+
+    std::string join(const std::vector<std::string> &args)
+    {
+        std::string ret;
+        for (auto &a : args)
+        {
+            if (!ret.empty())
+                ret += ' ';
+            ret += a;
+        }
+        return ret;
+    }
+
+    std::string json_escape(const std::string &s)
+    {
+        std::string ret;
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                ret += '\\';
+            ret += c;
+        }
+        return ret;
+    }
+
+    void write_json(std::ostream &os, const std::vector<result> &results)
+    {
+        os << "{\n  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const result &r = results[i];
+            char buf[512];
+            std::snprintf(buf, sizeof(buf),
+                    "    {\"name\": \"%s\", \"options\": %zu, \"args\": %zu, \"threads\": %u, \"iterations\": %llu, "
+                    "\"ns_per_op\": %.1f, \"ns_per_arg\": %.2f, \"allocs_per_op\": %.2f, "
+                    "\"peak_rss_kb\": %ld, \"ok\": %s}%s\n",
+                    json_escape(r.name).c_str(), r.options, r.args, r.threads, r.iterations,
+                    r.ns_per_op, r.ns_per_arg, r.allocs_per_op,
+                    r.peak_rss_kb, r.ok ? "true" : "false",
+                    i + 1 < results.size() ? "," : "");
+            os << buf;
+        }
+        os << "  ],\n  \"peak_rss_kb\": " << peak_rss_kb() << "\n}\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    cmdline::parser a;
+    a.add<double>("min-time", 't', "minimum seconds spent on each benchmark", false, 0.2);
+    a.add<size_t>("max-options", 'o', "largest schema to benchmark", false, 10000);
+    a.add<size_t>("max-args", 'n', "largest argv to benchmark", false, 1000000);
+    a.add<unsigned>("threads", 'j', "most threads for batch_parse, 0 for one per core", false, 0);
+    a.add<std::string>("filter", 'f', "only run benchmarks whose name contains this", false, "");
+    a.add<std::string>("output", 'O', "write JSON here instead of stdout", false, "");
+    a.parse_check(argc, argv);
+
+    const double min_time = a.get<double>("min-time");
+    const size_t max_options = a.get<size_t>("max-options");
+    const size_t max_args = a.get<size_t>("max-args");
+    const std::string filter = a.get<std::string>("filter");
+    unsigned max_threads = a.get<unsigned>("threads");
+    if (max_threads == 0)
+        max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    auto enabled = [&](const std::string &name) {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    };
+
+    std::vector<result> results;
+
+    const size_t option_counts[] = { 10, 100, 1000, 10000 };
+    const size_t arg_counts[] = { 10, 1000, 100000, 1000000 };
+
+    for (size_t options : option_counts)
+    {
+        if (options > max_options)
+            continue;
+
+        if (enabled("add")) {
+            results.push_back(measure("add", options, 0, min_time, [&]() {
+                cmdline::parser p;
+                build_schema(p, options);
+                return true;
+            }));
+        }
+
+        cmdline::parser p;
+        std::vector<cmdline::option_ref<int> > int_refs = build_schema(p, options);
+
+        for (size_t args : arg_counts)
+        {
+            if (args > max_args)
+                continue;
+
+            std::vector<std::string> storage = build_args(options, args);
+            std::vector<const char*> argv_(storage.size());
+            for (size_t i = 0; i < storage.size(); i++)
+                argv_[i] = storage[i].c_str();
+
+            if (enabled("parse_argv")) {
+                results.push_back(measure("parse_argv", options, args, min_time, [&]() {
+                    return p.parse(static_cast<int>(argv_.size()), argv_.data());
+                }));
+            }
+
+            if (enabled("parse_string") && args <= 100000) {
+                std::string line = join(storage);
+                results.push_back(measure("parse_string", options, args, min_time, [&]() {
+                    return p.parse(line);
+                }));
+            }
+        }
+
+        // 100,000 command lines of 10 arguments each
+        if (enabled("batch_parse")) {
+            std::vector<std::string> lines;
+            for (size_t i = 0; i < 100000; i++)
+                lines.push_back(join(build_args(options, 10 + i % 7)));
+            std::vector<unsigned> thread_counts;
+            for (unsigned threads = 1; threads < max_threads; threads *= 2)
+                thread_counts.push_back(threads);
+            thread_counts.push_back(max_threads);
+
+            for (unsigned threads : thread_counts)
+            {
+                result r = measure("batch_parse", options, lines.size(), min_time, [&]() {
+                    return cmdline::batch_parse(p.schema(), lines, threads).ok();
+                });
+                r.threads = threads;
+                results.push_back(r);
+            }
+        }
+
+        std::vector<std::string> int_names, flag_names;
+        for (size_t i = 0; i < options; i++)
+        {
+            if (kind_of(i) == int_option)
+                int_names.push_back(option_name(i));
+            if (kind_of(i) == flag_option)
+                flag_names.push_back(option_name(i));
+        }
+
+        if (enabled("get") && !int_names.empty()) {
+            results.push_back(measure("get", options, int_names.size(), min_time, [&]() {
+                long sum = 0;
+                for (auto &name : int_names)
+                    sum += p.get<int>(name);
+                return sum >= 0;
+            }));
+        }
+
+        if (enabled("option_ref") && !int_refs.empty()) {
+            results.push_back(measure("option_ref", options, int_refs.size(), min_time, [&]() {
+                long sum = 0;
+                for (auto &ref : int_refs)
+                    sum += ref.get() + ref.has_set();
+                return sum >= 0;
+            }));
+        }
+
+        if (enabled("exist") && !flag_names.empty()) {
+            results.push_back(measure("exist", options, flag_names.size(), min_time, [&]() {
+                size_t n = 0;
+                for (auto &name : flag_names)
+                    n += p.exist(name);
+                return n <= flag_names.size();
+            }));
+        }
+
+        if (enabled("usage")) {
+            results.push_back(measure("usage", options, 0, min_time, [&]() {
+                return !p.usage().empty();
+            }));
+        }
+
+        // usage() above is cached after the first call, this renders it
+        if (enabled("usage_render")) {
+            cmdline::usage_format format;
+            format.width = 100;
+            results.push_back(measure("usage_render", options, 0, min_time, [&]() {
+                return !p.schema().usage("cmdline_benchmark", format).empty();
+            }));
+        }
+    }
+
+    const std::string output = a.get<std::string>("output");
+    if (output.empty()) {
+        write_json(std::cout, results);
+    } else {
+        std::ofstream os(output.c_str());
+        write_json(os, results);
+    }
+    return 0;
+}
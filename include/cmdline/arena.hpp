@@ -0,0 +1,252 @@
+/*
+  Copyright (c) 2009-2019, Hideyuki Tanaka, Joel
+  All rights reserved.
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+  * Neither the name of the <organization> nor the
+  names of its contributors may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+  THIS SOFTWARE IS PROVIDED BY <copyright holder> ''AS IS'' AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "string_ref.hpp"
+
+namespace cmdline { namespace detail {
+    // bump allocator for objects that live as long as their owner. memory
+    // comes in blocks of growing size that are released together when the
+    // arena is destroyed; destructors of the objects are not called.
+    class arena
+    {
+    public:
+        explicit arena(size_t first_block = 4096) : next_size_(first_block) {}
+        arena(const arena &) = delete;
+        arena &operator=(const arena &) = delete;
+        ~arena()
+        {
+            while (head_) {
+                block *prev = head_->prev;
+                std::free(head_);
+                head_ = prev;
+            }
+        }
+
+        void *allocate(size_t size, size_t align)
+        {
+            char *p = align_up(cur_, align);
+            if (!p || p + size > end_) {
+                grow(size + align);
+                p = align_up(cur_, align);
+            }
+            cur_ = p + size;
+            return p;
+        }
+
+        template <class T, class... Args>
+        T *create(Args&&... args)
+        {
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        // copy of s followed by '\0'
+        string_ref copy(string_ref s)
+        {
+            char *p = static_cast<char*>(allocate(s.size() + 1, 1));
+            std::memcpy(p, s.data(), s.size());
+            p[s.size()] = '\0';
+            return string_ref(p, s.size());
+        }
+
+    private:
+        struct block
+        {
+            block *prev;
+        };
+
+        static char *align_up(char *p, size_t align)
+        {
+            uintptr_t u = reinterpret_cast<uintptr_t>(p);
+            return reinterpret_cast<char*>((u + align - 1) & ~(uintptr_t(align) - 1));
+        }
+
+        void grow(size_t min_size)
+        {
+            size_t size = std::max(next_size_, min_size + sizeof(block));
+            block *b = static_cast<block*>(std::malloc(size));
+            if (!b)
+                throw std::bad_alloc();
+            b->prev = head_;
+            head_ = b;
+            cur_ = reinterpret_cast<char*>(b + 1);
+            end_ = reinterpret_cast<char*>(b) + size;
+            next_size_ = std::min<size_t>(next_size_ * 2, 1 << 20);
+        }
+
+        block *head_ = nullptr;
+        char *cur_ = nullptr;
+        char *end_ = nullptr;
+        size_t next_size_;
+    };
+
+    // FNV-1a
+    inline size_t hash_string(string_ref s)
+    {
+        uint64_t h = 14695981039346656037ull;
+        for (char c : s)
+            h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+
+    // open addressing hash table from strings to values. keys are not
+    // copied and must outlive the map.
+    template <class V>
+    class string_map
+    {
+    public:
+        bool empty() const { return count_ == 0; }
+        size_t size() const { return count_; }
+
+        const V *find(string_ref key) const
+        {
+            if (table_.empty())
+                return nullptr;
+            size_t mask = table_.size() - 1;
+            for (size_t i = hash_string(key) & mask;; i = (i + 1) & mask)
+            {
+                const entry &e = table_[i];
+                if (!e.key)
+                    return nullptr;
+                if (string_ref(e.key, e.size) == key)
+                    return &e.value;
+            }
+        }
+
+        // replaces the value of an existing key
+        void insert(string_ref key, const V &value)
+        {
+            if ((count_ + 1) * 2 > table_.size())
+                rehash(table_.empty() ? 64 : table_.size() * 2);
+
+            size_t mask = table_.size() - 1;
+            for (size_t i = hash_string(key) & mask;; i = (i + 1) & mask)
+            {
+                entry &e = table_[i];
+                if (!e.key) {
+                    e = entry{key.data(), key.size(), value};
+                    ++count_;
+                    return;
+                }
+                if (string_ref(e.key, e.size) == key) {
+                    e.value = value;
+                    return;
+                }
+            }
+        }
+
+        // entries after the removed one that would no longer be found are
+        // moved back into the gap, so no tombstones are needed
+        void erase(string_ref key)
+        {
+            if (table_.empty())
+                return;
+            size_t mask = table_.size() - 1;
+            size_t i = hash_string(key) & mask;
+            for (;; i = (i + 1) & mask)
+            {
+                if (!table_[i].key)
+                    return;
+                if (string_ref(table_[i].key, table_[i].size) == key)
+                    break;
+            }
+            for (size_t j = (i + 1) & mask; table_[j].key; j = (j + 1) & mask)
+            {
+                size_t home = hash_string(string_ref(table_[j].key, table_[j].size)) & mask;
+                if (((j - home) & mask) >= ((j - i) & mask)) {
+                    table_[i] = table_[j];
+                    i = j;
+                }
+            }
+            table_[i] = entry{nullptr, 0, V()};
+            --count_;
+        }
+
+        void clear()
+        {
+            table_.clear();
+            count_ = 0;
+        }
+
+    private:
+        struct entry
+        {
+            const char *key;
+            size_t size;
+            V value;
+        };
+
+        void rehash(size_t size)
+        {
+            std::vector<entry> old(size, entry{nullptr, 0, V()});
+            old.swap(table_);
+            size_t mask = size - 1;
+            for (auto &e : old)
+            {
+                if (!e.key)
+                    continue;
+                size_t i = hash_string(string_ref(e.key, e.size)) & mask;
+                while (table_[i].key)
+                    i = (i + 1) & mask;
+                table_[i] = e;
+            }
+        }
+
+        std::vector<entry> table_;
+        size_t count_ = 0;
+    };
+
+    // strings stored once in an arena. equal strings share their storage,
+    // and interning a string that is already there does not allocate.
+    class string_pool
+    {
+    public:
+        explicit string_pool(arena &a) : arena_(a) {}
+
+        string_ref intern(string_ref s)
+        {
+            if (const string_ref *p = strings_.find(s))
+                return *p;
+            string_ref ref = arena_.copy(s);
+            strings_.insert(ref, ref);
+            return ref;
+        }
+
+    private:
+        arena &arena_;
+        string_map<string_ref> strings_;
+    };
+} }
@@ -0,0 +1,242 @@
+/*
+  Copyright (c) 2009-2019, Hideyuki Tanaka, Joel
+  All rights reserved.
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+  * Neither the name of the <organization> nor the
+  names of its contributors may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+  THIS SOFTWARE IS PROVIDED BY <copyright holder> ''AS IS'' AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+
+#include "schema.hpp"
+
+namespace cmdline
+{
+    // outcome of batch_parse(): which lines failed and why. lines that
+    // parsed take no space.
+    class batch_result
+    {
+    public:
+        typedef std::pair<size_t, std::string> failure;
+
+        size_t size() const { return size_; }
+        bool ok() const { return failures_.empty(); }
+        bool ok(size_t line) const { return !find(line); }
+
+        // the error_full() text of line, or "" if it parsed
+        const std::string &error(size_t line) const
+        {
+            static const std::string none;
+            const failure *f = find(line);
+            return f ? f->second : none;
+        }
+
+        // failed lines in input order
+        const std::vector<failure> &failures() const { return failures_; }
+
+    private:
+        template <class Visitor>
+        friend batch_result batch_parse(const schema &, const std::string *, size_t, unsigned, Visitor);
+
+        static bool line_less(const failure &f, size_t line) { return f.first < line; }
+
+        const failure *find(size_t line) const
+        {
+            auto it = std::lower_bound(failures_.begin(), failures_.end(), line, line_less);
+            return it != failures_.end() && it->first == line ? &*it : nullptr;
+        }
+
+        size_t size_ = 0;
+        std::vector<failure> failures_;
+    };
+
+    namespace detail
+    {
+        // [begin, end) of lines left to a worker, packed in one word so
+        // that the owner taking from the front and thieves taking from the
+        // back agree through a single compare-and-swap.
+        class work_range
+        {
+        public:
+            void reset(uint32_t begin, uint32_t end) { range_.store(pack(begin, end), std::memory_order_relaxed); }
+
+            // take up to grain lines from the front
+            bool take(uint32_t grain, uint32_t &begin, uint32_t &end)
+            {
+                uint64_t r = range_.load(std::memory_order_acquire);
+                for (;;) {
+                    uint32_t b = first(r), e = last(r);
+                    if (b >= e)
+                        return false;
+                    uint32_t n = std::min(grain, e - b);
+                    if (range_.compare_exchange_weak(r, pack(b + n, e), std::memory_order_acq_rel)) {
+                        begin = b;
+                        end = b + n;
+                        return true;
+                    }
+                }
+            }
+
+            // move the back half of victim's lines to this range, which
+            // must be empty
+            bool steal(work_range &victim)
+            {
+                uint64_t r = victim.range_.load(std::memory_order_acquire);
+                for (;;) {
+                    uint32_t b = first(r), e = last(r);
+                    if (b >= e)
+                        return false;
+                    uint32_t n = (e - b + 1) / 2;
+                    if (victim.range_.compare_exchange_weak(r, pack(b, e - n), std::memory_order_acq_rel)) {
+                        range_.store(pack(e - n, e), std::memory_order_release);
+                        return true;
+                    }
+                }
+            }
+
+        private:
+            static uint64_t pack(uint32_t begin, uint32_t end) { return static_cast<uint64_t>(begin) << 32 | end; }
+            static uint32_t first(uint64_t r) { return static_cast<uint32_t>(r >> 32); }
+            static uint32_t last(uint64_t r) { return static_cast<uint32_t>(r); }
+
+            std::atomic<uint64_t> range_{0};
+        };
+
+        struct no_visitor
+        {
+            void operator()(size_t, const parse_result &) const {}
+        };
+    }
+
+    // parses count command lines, each split like parser::parse(const
+    // std::string&), against one schema on the given number of threads
+    // (0 for one per core). lines are handed out in contiguous blocks and
+    // idle threads steal half of the work left to a busy one.
+    //
+    // visit(line, result) is called on the worker threads for every line,
+    // whether or not it parsed. an exception thrown by it stops the batch
+    // and is rethrown.
+    template <class Visitor>
+    batch_result batch_parse(const schema &s, const std::string *lines, size_t count,
+                             unsigned threads, Visitor visit)
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, count)));
+
+        std::vector<detail::work_range> ranges(threads);
+        std::vector<std::vector<batch_result::failure> > failures(threads);
+        std::atomic<bool> stop(false);
+        std::exception_ptr error;
+        std::mutex error_lock;
+
+        // ranges index lines with 32 bits, so larger batches go in blocks
+        const size_t block_size = static_cast<size_t>(std::numeric_limits<uint32_t>::max());
+        for (size_t base = 0; base < count && !stop.load(); base += block_size)
+        {
+            uint32_t n = static_cast<uint32_t>(std::min(block_size, count - base));
+            uint32_t grain = std::max<uint32_t>(1, std::min<uint32_t>(64, n / (threads * 16)));
+            for (unsigned t = 0; t < threads; t++)
+                ranges[t].reset(static_cast<uint32_t>(uint64_t(n) * t / threads),
+                                static_cast<uint32_t>(uint64_t(n) * (t + 1) / threads));
+
+            auto work = [&](unsigned self) {
+                parse_result r;
+                try {
+                    uint32_t begin, end;
+                    for (;;)
+                    {
+                        if (!ranges[self].take(grain, begin, end)) {
+                            bool stolen = false;
+                            for (unsigned k = 1; k < threads && !stolen; k++)
+                                stolen = ranges[self].steal(ranges[(self + k) % threads]);
+                            if (!stolen)
+                                return;
+                            continue;
+                        }
+
+                        for (uint32_t i = begin; i < end; i++)
+                        {
+                            if (stop.load(std::memory_order_relaxed))
+                                return;
+
+                            size_t line = base + i;
+                            if (!s.parse(lines[line], r))
+                                failures[self].emplace_back(line, r.error_full());
+                            visit(line, static_cast<const parse_result&>(r));
+                        }
+                    }
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(error_lock);
+                    if (!error)
+                        error = std::current_exception();
+                    stop.store(true);
+                }
+            };
+
+            std::vector<std::thread> workers;
+            for (unsigned t = 1; t < threads; t++)
+                workers.emplace_back(work, t);
+            work(0);
+            for (auto &w : workers)
+                w.join();
+        }
+
+        if (error)
+            std::rethrow_exception(error);
+
+        batch_result ret;
+        ret.size_ = count;
+        size_t total = 0;
+        for (auto &f : failures)
+            total += f.size();
+        ret.failures_.reserve(total);
+        for (auto &f : failures)
+            std::move(f.begin(), f.end(), std::back_inserter(ret.failures_));
+        std::sort(ret.failures_.begin(), ret.failures_.end(),
+                  [](const batch_result::failure &a, const batch_result::failure &b) { return a.first < b.first; });
+        return ret;
+    }
+
+    template <class Visitor>
+    batch_result batch_parse(const schema &s, const std::vector<std::string> &lines,
+                             unsigned threads, Visitor visit)
+    {
+        return batch_parse(s, lines.data(), lines.size(), threads, visit);
+    }
+
+    inline batch_result batch_parse(const schema &s, const std::vector<std::string> &lines, unsigned threads = 0)
+    {
+        return batch_parse(s, lines.data(), lines.size(), threads, detail::no_visitor());
+    }
+}
@@ -0,0 +1,363 @@
+/*
+  Copyright (c) 2009-2019, Hideyuki Tanaka, Joel
+  All rights reserved.
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+  * Neither the name of the <organization> nor the
+  names of its contributors may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+  THIS SOFTWARE IS PROVIDED BY <copyright holder> ''AS IS'' AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <limits>
+#include <system_error>
+#include <type_traits>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+
+namespace cmdline
+{
+    // result of from_chars(), modelled after C++17 std::from_chars_result.
+    // ptr points to the first character that was not consumed.
+    struct from_chars_result
+    {
+        const char *ptr;
+        std::errc ec;
+    };
+
+    namespace detail
+    {
+        template <class T>
+        struct is_character : std::false_type {};
+        template <> struct is_character<char> : std::true_type {};
+        template <> struct is_character<signed char> : std::true_type {};
+        template <> struct is_character<unsigned char> : std::true_type {};
+        template <> struct is_character<wchar_t> : std::true_type {};
+        template <> struct is_character<char16_t> : std::true_type {};
+        template <> struct is_character<char32_t> : std::true_type {};
+
+        // types handled by from_chars(). character types keep their stream
+        // semantics (a single character, not a number).
+        template <class T>
+        struct is_numeric : std::integral_constant<bool,
+                std::is_arithmetic<T>::value && !is_character<T>::value> {};
+
+        inline int digit_value(char c)
+        {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            char l = static_cast<char>(c | 0x20);
+            if (l >= 'a' && l <= 'z')
+                return l - 'a' + 10;
+            return 99;
+        }
+
+        inline bool iequals(const char *first, const char *last, const char *lower)
+        {
+            for (; first != last; ++first, ++lower)
+                if (!*lower || (*first | 0x20) != *lower)
+                    return false;
+            return !*lower;
+        }
+
+        template <class T>
+        from_chars_result parse_integer(const char *first, const char *last, T &value)
+        {
+            typedef typename std::make_unsigned<T>::type U;
+
+            const char *p = first;
+            bool neg = false;
+            if (p != last && (*p == '+' || *p == '-')) {
+                neg = *p == '-';
+                ++p;
+            }
+            if (neg && !std::is_signed<T>::value)
+                return {first, std::errc::invalid_argument};
+
+            int base = 10;
+            if (last - p > 2 && p[0] == '0') {
+                switch (p[1] | 0x20) {
+                    case 'x': base = 16; break;
+                    case 'o': base = 8; break;
+                    case 'b': base = 2; break;
+                    default: break;
+                }
+                if (base != 10 && digit_value(p[2]) < base)
+                    p += 2;
+                else
+                    base = 10;
+            }
+
+            const U limit = neg ? static_cast<U>(static_cast<U>(std::numeric_limits<T>::max()) + 1)
+                                : static_cast<U>(std::numeric_limits<T>::max());
+            const U cutoff = static_cast<U>(limit / base);
+            const int cutlim = static_cast<int>(limit % base);
+
+            const char *digits = p;
+            U acc = 0;
+            bool overflow = false;
+            for (; p != last; ++p) {
+                int d = digit_value(*p);
+                if (d >= base)
+                    break;
+                if (acc > cutoff || (acc == cutoff && d > cutlim))
+                    overflow = true;
+                else
+                    acc = static_cast<U>(acc * base + d);
+            }
+
+            if (p == digits)
+                return {first, std::errc::invalid_argument};
+            if (overflow)
+                return {p, std::errc::result_out_of_range};
+
+            if (neg)
+                value = static_cast<T>(0 - acc);
+            else
+                value = static_cast<T>(acc);
+            return {p, std::errc()};
+        }
+
+        inline from_chars_result parse_bool(const char *first, const char *last, bool &value)
+        {
+            if (last - first == 1 && (*first == '0' || *first == '1')) {
+                value = *first == '1';
+                return {last, std::errc()};
+            }
+            if (iequals(first, last, "true")) {
+                value = true;
+                return {last, std::errc()};
+            }
+            if (iequals(first, last, "false")) {
+                value = false;
+                return {last, std::errc()};
+            }
+            return {first, std::errc::invalid_argument};
+        }
+
+        // bounds of the exact fast path of parse_floating() for T: the widest
+        // mantissa and the largest power of ten T holds exactly. long double
+        // has none, its precision differs between platforms, so it always
+        // goes to strtold.
+        template <class T>
+        struct fast_path_limits
+        {
+            static const int mantissa_bits = 0;
+            static const long max_scale = -1;
+        };
+
+        template <>
+        struct fast_path_limits<double>
+        {
+            static const int mantissa_bits = 53;
+            static const long max_scale = 22;
+        };
+
+        template <>
+        struct fast_path_limits<float>
+        {
+            static const int mantissa_bits = 24;
+            static const long max_scale = 10;
+        };
+
+        inline float strto(const char *s, char **end, float *) { return std::strtof(s, end); }
+        inline double strto(const char *s, char **end, double *) { return std::strtod(s, end); }
+        inline long double strto(const char *s, char **end, long double *) { return std::strtold(s, end); }
+
+        template <class T>
+        from_chars_result parse_floating(const char *first, const char *last, T &value)
+        {
+            // significant digits kept for the slow path; enough for a correctly
+            // rounded double, longer mantissas are truncated.
+            enum { max_digits = 768 };
+
+            static const double pow10[] = {
+                1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+
+            const char *p = first;
+            bool neg = false;
+            if (p != last && (*p == '+' || *p == '-')) {
+                neg = *p == '-';
+                ++p;
+            }
+
+            if (iequals(p, last, "inf") || iequals(p, last, "infinity")) {
+                if (!std::numeric_limits<T>::has_infinity)
+                    return {first, std::errc::invalid_argument};
+                value = neg ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::infinity();
+                return {last, std::errc()};
+            }
+            if (iequals(p, last, "nan")) {
+                if (!std::numeric_limits<T>::has_quiet_NaN)
+                    return {first, std::errc::invalid_argument};
+                value = std::numeric_limits<T>::quiet_NaN();
+                return {last, std::errc()};
+            }
+
+            char digits[max_digits + 1];
+            int ndigits = 0;
+            bool any_digit = false;
+            std::uint64_t mantissa = 0;
+            int mantissa_digits = 0;
+            bool truncated = false;
+            long exponent = 0;
+
+            for (bool fraction = false; p != last; ++p) {
+                if (*p == '.' && !fraction) {
+                    fraction = true;
+                    continue;
+                }
+                if (*p < '0' || *p > '9')
+                    break;
+                any_digit = true;
+                if (*p == '0' && ndigits == 0) {
+                    if (fraction)
+                        --exponent;
+                    continue;
+                }
+                if (ndigits < max_digits) {
+                    digits[ndigits++] = *p;
+                    if (fraction)
+                        --exponent;
+                } else {
+                    truncated = true;
+                    if (!fraction)
+                        ++exponent;
+                }
+                if (mantissa_digits < 19) {
+                    mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+                    ++mantissa_digits;
+                } else {
+                    truncated = true;
+                }
+            }
+
+            if (!any_digit)
+                return {first, std::errc::invalid_argument};
+
+            if (p != last && (*p | 0x20) == 'e') {
+                const char *q = p + 1;
+                bool eneg = false;
+                if (q != last && (*q == '+' || *q == '-')) {
+                    eneg = *q == '-';
+                    ++q;
+                }
+                if (q != last && *q >= '0' && *q <= '9') {
+                    long e = 0;
+                    for (; q != last && *q >= '0' && *q <= '9'; ++q)
+                        if (e < 100000)
+                            e = e * 10 + (*q - '0');
+                    exponent += eneg ? -e : e;
+                    p = q;
+                }
+            }
+
+            if (ndigits == 0) {
+                value = neg ? -T(0) : T(0);
+                return {p, std::errc()};
+            }
+
+            // exact fast path (Clinger): both the mantissa and the power of ten
+            // are representable in T, so a single rounding in T gives the
+            // right answer.
+            typedef fast_path_limits<T> limits;
+            long scale = exponent + (ndigits - mantissa_digits);
+            if (!truncated && mantissa <= (std::uint64_t(1) << limits::mantissa_bits) &&
+                scale >= -limits::max_scale && scale <= limits::max_scale) {
+                T d = static_cast<T>(mantissa);
+                d = scale < 0 ? d / static_cast<T>(pow10[-scale]) : d * static_cast<T>(pow10[scale]);
+                value = neg ? -d : d;
+                return {p, std::errc()};
+            }
+
+            // slow path: hand a normalized "digits e exponent" string to strtod.
+            // it never contains a decimal point, so the result does not depend
+            // on LC_NUMERIC.
+            char buf[max_digits + 32];
+            int n = 0;
+            if (neg)
+                buf[n++] = '-';
+            for (int i = 0; i < ndigits; ++i)
+                buf[n++] = digits[i];
+            buf[n++] = 'e';
+            long e = exponent;
+            if (e < 0) {
+                buf[n++] = '-';
+                e = -e;
+            }
+            char ebuf[24];
+            int en = 0;
+            do {
+                ebuf[en++] = static_cast<char>('0' + e % 10);
+                e /= 10;
+            } while (e);
+            while (en)
+                buf[n++] = ebuf[--en];
+            buf[n] = '\0';
+
+            int saved = errno;
+            errno = 0;
+            T ret = strto(buf, nullptr, static_cast<T*>(nullptr));
+            bool range = errno == ERANGE;
+            errno = saved;
+            if (range)
+                return {p, std::errc::result_out_of_range};
+            value = ret;
+            return {p, std::errc()};
+        }
+
+        template <class T>
+        from_chars_result from_chars(const char *first, const char *last, T &value, std::true_type /*integral*/)
+        {
+            return parse_integer(first, last, value);
+        }
+
+        inline from_chars_result from_chars(const char *first, const char *last, bool &value, std::true_type)
+        {
+            return parse_bool(first, last, value);
+        }
+
+        template <class T>
+        from_chars_result from_chars(const char *first, const char *last, T &value, std::false_type /*integral*/)
+        {
+            return parse_floating(first, last, value);
+        }
+    }
+
+    // locale-independent, non-allocating, non-throwing conversion of
+    // [first, last) to an integral or floating point value.
+    //
+    // integers accept an optional sign and the prefixes 0x (hex), 0o (octal)
+    // and 0b (binary); a bare leading zero stays decimal. bool accepts 0, 1,
+    // true and false. floating point accepts decimal notation with an
+    // optional exponent, inf, infinity and nan.
+    //
+    // on error value is left untouched and ec is invalid_argument or
+    // result_out_of_range.
+    template <class T>
+    typename std::enable_if<detail::is_numeric<T>::value, from_chars_result>::type
+    from_chars(const char *first, const char *last, T &value)
+    {
+        return detail::from_chars(first, last, value, std::is_integral<T>());
+    }
+}
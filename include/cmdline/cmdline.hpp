@@ -27,329 +27,201 @@
 
 #include <string>
 #include <vector>
-#include <map>
 #include <iostream>
 
-#include <cstring>
+#include <cstdlib>
 
 #include "detail.hpp"
 #include "error.hpp"
+#include "instrumentation.hpp"
 #include "options.hpp"
 #include "reader.hpp"
+#include "schema.hpp"
+#include "string_ref.hpp"
+#include "terminal.hpp"
 
 namespace cmdline
 {
-    template <class T>
-    struct of_helper
-    {
-        void expand(T arg) { r.add(arg); }
-        template <class... Args>
-        void of(const Args&... args) { int a[] = { (expand(args), 0)... }; }
-        one_of_reader<T> r;
-    };
-
+    // the values are sorted once; for long lists use the range
+    // constructor of one_of_reader
     template <class T, class... Args>
     one_of_reader<T> of(const Args&... args)
     {
-        of_helper<T> helper;
-        helper.of(args...);
-        return helper.r;
+        return one_of_reader<T>({ T(args)... });
     }
 
+    // a schema together with the result of its last parse. a parser is
+    // not meant to be shared between threads; to parse concurrently use
+    // schema() with one parse_result per thread.
     class parser
     {
     public:
-        parser() = default;
-        ~parser()
+        parser() : result_(schema_) {}
+
+        flag_ref add(string_ref name, char short_name = 0, string_ref desc = "")
         {
-            for(auto &pair : options_)
-                delete pair.second;
+            return flag_ref(schema_.add(name, short_name, desc), &result_.values());
         }
 
-        void add(const std::string &name, char short_name = 0, const std::string &desc = "")
+        template <class T>
+        option_ref<T> add(string_ref name, char short_name = 0,
+                          string_ref desc = "", bool need = true, const T def = T())
         {
-            if (options_.count(name))
-                throw cmdline::cmdline_error("multiple definition: " + name);
+            return add(name, short_name, desc, need, def, default_reader<T>());
+        }
 
-            options_[name] = new option::option_without_value(name, short_name, desc);
-            ordered_.push_back(options_[name]);
+        template <class T, class F>
+        option_ref<T> add(string_ref name, char short_name=0,
+                          string_ref desc = "", bool need = true, const T def = T(), F reader = F())
+        {
+            return option_ref<T>(schema_.add<T, F>(name, short_name, desc, need, def, reader), &result_.values());
         }
 
+        // see schema::add(string_ref, char, string_ref, T*, bool)
         template <class T>
-        void add(const std::string &name, char short_name = 0,
-                 const std::string &desc = "", bool need = true, const T def = T())
+        option_ref<T> add(string_ref name, char short_name, string_ref desc, T *target, bool need = false)
         {
-            add(name, short_name, desc, need, def, default_reader<T>());
+            return add(name, short_name, desc, target, need, default_reader<T>());
         }
 
         template <class T, class F>
-        void add(const std::string &name, char short_name=0,
-                 const std::string &desc = "", bool need = true, const T def = T(), F reader = F())
+        option_ref<T> add(string_ref name, char short_name, string_ref desc, T *target, bool need, F reader)
         {
-            if (options_.count(name))
-                throw cmdline_error("multiple definition: "+name);
-            options_[name]=new option::option_with_value_with_reader<T, F>(name, short_name, need, def, desc, reader);
-            ordered_.push_back(options_[name]);
+            return option_ref<T>(schema_.add(name, short_name, desc, target, need, reader), &result_.values());
         }
 
-        void footer(const std::string &f) { footer_ = f; }
-        void set_program_name(const std::string &name) { program_name_ = name; }
-
-        bool exist(const std::string &name) const
+        flag_ref add(string_ref name, char short_name, string_ref desc, bool *target)
         {
-            if (options_.count(name) == 0)
-                throw cmdline_error("there is no flag: --" + name);
-            return options_.find(name)->second->has_set();
+            return flag_ref(schema_.add(name, short_name, desc, target), &result_.values());
         }
 
+        // see schema::add_list()
         template <class T>
-        const T &get(const std::string &name) const
+        option_ref<std::vector<T> > add_list(string_ref name, char short_name = 0,
+                                             string_ref desc = "", bool need = false, char delimiter = 0)
         {
-            if (options_.count(name)==0)
-                throw cmdline_error("there is no flag: --" + name);
-
-            auto opt = options_.find(name)->second;
-            auto p = dynamic_cast<const option::option_with_value<T>*>(opt);
-            if (!p)
-                throw cmdline_error("type mismatch flag '" + name + "'");
-            return p->get();
+            return add_list<T>(name, short_name, desc, need, delimiter, default_reader<T>());
         }
 
-        const std::vector<std::string> &rest() const { return others_; }
+        template <class T, class F>
+        option_ref<std::vector<T> > add_list(string_ref name, char short_name,
+                                             string_ref desc, bool need, char delimiter, F reader)
+        {
+            return option_ref<std::vector<T> >(schema_.add_list<T, F>(name, short_name, desc, need, delimiter, reader),
+                                               &result_.values());
+        }
 
-        bool parse(const std::string &arg)
+        void footer(const std::string &f) { schema_.footer(f); }
+        void set_program_name(const std::string &name)
         {
-            std::vector<std::string> args;
-
-            std::string buf;
-            bool in_quote=false;
-            for (std::string::size_type i=0; i<arg.length(); i++)
-            {
-                if (arg[i] == '\"') {
-                    in_quote=!in_quote;
-                    continue;
-                }
-
-                if ( arg[i] == ' ' && !in_quote ) {
-                    args.push_back(buf);
-                    buf = "";
-                    continue;
-                }
-
-                if (arg[i] == '\\') {
-                    i++;
-                    if (i >= arg.length()) {
-                        errors_.emplace_back("unexpected occurrence of '\\' at end of string");
-                        return false;
-                    }
-                }
-
-                buf+=arg[i];
-            }
+            program_name_ = name;
+            usage_.clear();
+        }
 
-            if (in_quote){
-                errors_.emplace_back("quote is not closed");
-                return false;
-            }
+        // see schema::section()
+        void section(const std::string &title) { schema_.section(title); }
 
-            if (buf.length()>0)
-                args.push_back(buf);
+        // see schema::set_zero_copy()
+        void set_zero_copy(bool zero_copy) { schema_.set_zero_copy(zero_copy); }
 
-            for(auto &var0 : args)
-                std::cout << "\"" << var0 <<"\"" << std::endl;
+        // see schema::set_response_files()
+        void set_response_files(bool response_files) { schema_.set_response_files(response_files); }
 
-            return parse(args);
+        // see schema::add_config()
+        option_ref<std::string> add_config(const std::string &name, char short_name = 0,
+                                           const std::string &desc = "config file",
+                                           const std::string &path = "")
+        {
+            return option_ref<std::string>(schema_.add_config(name, short_name, desc, path), &result_.values());
         }
 
-        bool parse(const std::vector<std::string> &args)
-        {
-            int argc = static_cast<int>(args.size());
-            std::vector<const char*> argv(argc);
+        // see schema::bind_env()
+        void bind_env(const std::string &name, const std::string &var) { schema_.bind_env(name, var); }
 
-            for (int i=0; i<argc; i++)
-                argv[i] = args[i].c_str();
+        // see schema::set_env_prefix()
+        void set_env_prefix(const std::string &prefix) { schema_.set_env_prefix(prefix); }
 
-            return parse(argc, &argv[0]);
-        }
+        // see schema::set_lazy()
+        void set_lazy(bool lazy) { schema_.set_lazy(lazy); }
 
-        bool parse(int argc, const char * const argv[])
-        {
-            errors_.clear();
-            others_.clear();
+        // see schema::set_abbreviations()
+        void set_abbreviations(bool abbreviations) { schema_.set_abbreviations(abbreviations); }
 
-            if (argc<1){
-                errors_.emplace_back("argument number must be longer than 0");
-                return false;
-            }
+        bool exist(const std::string &name) const { return result_.exist(name); }
 
-            if (program_name_.empty())
-                program_name_ = argv[0];
-
-            std::map<char, std::string> lookup;
-            for(auto &p : options_)
-            {
-                if (p.first.empty())
-                    continue;
-
-                char initial = p.second->short_name();
-                if (initial)
-                {
-                    if (lookup.count(initial) > 0) {
-                        lookup[initial] = "";
-                        errors_.emplace_back(std::string("short option '") + initial+ "' is ambiguous");
-                        return false;
-                    } else {
-                        lookup[initial] = p.first;
-                    }
-                }
-            }
+        template <class T>
+        const T &get(const std::string &name) const { return result_.get<T>(name); }
 
-            for (int i=1; i<argc; i++)
-            {
-                if (strncmp(argv[i], "--", 2) == 0)
-                {
-                    const char *p = strchr(argv[i]+2, '=');
-                    if (p){
-                        std::string name(argv[i] + 2, p);
-                        std::string val(p + 1);
-                        set_option(name, val);
-                    } else {
-                        std::string name(argv[i] + 2);
-                        if (options_.count(name) == 0) {
-                            errors_.emplace_back("undefined option: --" + name);
-                            continue;
-                        }
-                        if (options_[name]->has_value())
-                        {
-                            if (i + 1 >= argc) {
-                                errors_.emplace_back("option needs value: --" + name);
-                                continue;
-                            } else {
-                                i++;
-                                set_option(name, argv[i]);
-                            }
-                        } else{
-                            set_option(name);
-                        }
-                    }
-                }
-                else if (strncmp(argv[i], "-", 1) == 0)
-                {
-                    if (!argv[i][1])
-                        continue;
-
-                    char last = argv[i][1];
-                    for (int j = 2; argv[i][j]; j++)
-                    {
-                        last=argv[i][j];
-                        if (lookup.count(argv[i][j-1])==0) {
-                            errors_.emplace_back(std::string("undefined short option: -") + (argv[i][j - 1]) );
-                            continue;
-                        }
-                        if (lookup[argv[i][j-1]].empty()) {
-                            errors_.emplace_back(std::string("ambiguous short option: -") + (argv[i][j-1]) );
-                            continue;
-                        }
-                        set_option(lookup[argv[i][j-1]]);
-                    }
-
-                    if (lookup.count(last) == 0) {
-                        errors_.emplace_back(std::string("undefined short option: -") + last);
-                        continue;
-                    }
-
-                    if (lookup[last].empty()) {
-                        errors_.emplace_back(std::string("ambiguous short option: -") + last);
-                        continue;
-                    }
-
-                    if (i+1<argc && options_[lookup[last]]->has_value()) {
-                        set_option(lookup[last], argv[i+1]);
-                        i++;
-                    } else {
-                        set_option(lookup[last]);
-                    }
-                }
-                else{
-                    others_.emplace_back(argv[i]);
-                }
-            }
+        // raw text of the last value given to an option. it is a view into
+        // the parsed arguments and is valid as long as they are.
+        string_ref raw(const std::string &name) const { return result_.raw(name); }
 
-            for (auto &p : options_) {
-                if (!p.second->valid())
-                    errors_.push_back("need option: --" + std::string(p.first));
-            }
+        const std::vector<std::string> &rest() const { return result_.rest(); }
+        const std::vector<string_ref> &rest_view() const { return result_.rest_view(); }
 
-            return errors_.empty();
-        }
+        bool parse(const std::string &arg) { return parsed(schema_.parse(arg, result_)); }
+        bool parse(const std::vector<std::string> &args) { return parsed(schema_.parse(args, result_)); }
+        bool parse(int argc, const char * const argv[]) { return parsed(schema_.parse(argc, argv, result_)); }
 
         void parse_check(const std::string &arg) {
-            if (!options_.count("help"))
+            if (!schema_.find("help"))
                 add("help", '?', "print this message");
             check(0, parse(arg));
         }
 
         void parse_check(const std::vector<std::string> &args) {
-            if (!options_.count("help"))
+            if (!schema_.find("help"))
                 add("help", '?', "print this message");
             check(args.size(), parse(args));
         }
 
         void parse_check(int argc, char *argv[]) {
-            if (!options_.count("help"))
+            if (!schema_.find("help"))
                 add("help", '?', "print this message");
             check(argc, parse(argc, argv));
         }
 
-        std::string error() const {
-            return errors_.empty() ? "" : errors_[0];
-        }
+        // see parse_result::set_instrumentation()
+        void set_instrumentation(instrumentation *inst) { result_.set_instrumentation(inst); }
 
-        std::string error_full() const
-        {
-            std::ostringstream oss;
-            for (auto &err : errors_)
-                oss << err << std::endl;
-            return oss.str();
-        }
+        // see parse_result::validate_all()
+        bool validate_all() { return result_.validate_all(); }
+
+        std::string error() const { return result_.error(); }
+        std::string error_full() const { return result_.error_full(); }
 
-        std::string usage() const
+        // the full help text. it is kept until the options, the footer, the
+        // program name or the terminal width change.
+        const std::string &usage() const
         {
-            std::ostringstream oss;
-            oss << "usage: " << program_name_ << " ";
-            for (auto &o : ordered_)
-            {
-                if (o->must())
-                    oss << o->short_description() << " ";
+            size_t width = detail::terminal_width();
+            if (usage_.empty() || usage_revision_ != schema_.revision() || usage_width_ != width) {
+                usage_format format;
+                format.width = width;
+                usage_ = schema_.usage(program_name_, format);
+                usage_revision_ = schema_.revision();
+                usage_width_ = width;
             }
+            return usage_;
+        }
 
-            oss << "[options] ... " << std::endl;
-            oss << "options:" << std::endl;
-
-            size_t max_width=0;
-            for (auto &o : ordered_)
-                max_width = std::max(max_width, o->name().length());
+        // part of the help text, e.g. one section or one page of options
+        std::string usage(const usage_format &format) const { return schema_.usage(program_name_, format); }
 
-            for (auto &o : ordered_)
-            {
-                if (o->short_name())
-                    oss << "  -" << o->short_name() << ", ";
-                else
-                    oss << "      ";
+        cmdline::schema &schema() { return schema_; }
+        const cmdline::schema &schema() const { return schema_; }
+        const parse_result &result() const { return result_; }
 
-                oss << "--" << o->name();
-                for (size_t j = o->name().length(); j < max_width + 4; j++)
-                    oss<<' ';
-                oss << o->description() << std::endl;
+    private:
+        bool parsed(bool ok)
+        {
+            if (program_name_.empty()) {
+                program_name_ = result_.program_name();
+                usage_.clear();
             }
-
-            oss << std::endl;
-            oss << footer_ << std::endl;
-
-            return oss.str();
+            return ok;
         }
 
-    private:
         void check(int argc, bool ok)
         {
             if ( (argc == 1 && !ok) || exist("help") ) {
@@ -363,36 +235,11 @@ namespace cmdline
             }
         }
 
-        void set_option(const std::string &name)
-        {
-            if (options_.count(name) == 0) {
-                errors_.emplace_back("undefined option: --" + name);
-                return;
-            }
-            if (!options_[name]->set()) {
-                errors_.emplace_back("option needs value: --" + name);
-                return;
-            }
-        }
-
-        void set_option(const std::string &name, const std::string &value)
-        {
-            if (options_.count(name) == 0) {
-                errors_.emplace_back("undefined option: --" + name);
-                return;
-            }
-            if (!options_[name]->set(value)) {
-                errors_.emplace_back("option value is invalid: --"+name+"="+value);
-                return;
-            }
-        }
-
-    private:
-        std::string footer_;
+        cmdline::schema schema_;
+        parse_result result_;
         std::string program_name_;
-        std::map<std::string, option::option_base*> options_;
-        std::vector<option::option_base*> ordered_;
-        std::vector<std::string> others_;
-        std::vector<std::string> errors_;
+        mutable std::string usage_;
+        mutable unsigned long usage_revision_ = 0;
+        mutable size_t usage_width_ = 0;
     };
 }
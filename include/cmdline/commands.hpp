@@ -0,0 +1,238 @@
+/*
+  Copyright (c) 2009-2019, Hideyuki Tanaka, Joel
+  All rights reserved.
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+  * Neither the name of the <organization> nor the
+  names of its contributors may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+  THIS SOFTWARE IS PROVIDED BY <copyright holder> ''AS IS'' AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cstdlib>
+
+#include "error.hpp"
+#include "schema.hpp"
+#include "string_ref.hpp"
+#include "suggest.hpp"
+
+namespace cmdline
+{
+    // git style front end: "prog <command> [options] ...". each command
+    // registers a function that adds its options to a schema; the schema
+    // is only built when the command is chosen, so a program with many
+    // commands pays for the one that runs.
+    class command_parser
+    {
+    public:
+        typedef std::function<void(cmdline::schema &)> factory;
+
+        void add(const std::string &name, const std::string &summary, factory make)
+        {
+            if (route(name))
+                throw cmdline_error("multiple definition: " + name);
+            entry c;
+            c.name = name;
+            c.summary = summary;
+            c.make = std::move(make);
+            commands_.insert(std::upper_bound(commands_.begin(), commands_.end(), c, entry_less), std::move(c));
+            chosen_ = nullptr;
+            help_ = false;
+        }
+
+        void footer(const std::string &f) { footer_ = f; }
+        void set_program_name(const std::string &name) { program_name_ = name; }
+
+        bool parse(int argc, const char * const argv[])
+        {
+            errors_.clear();
+            chosen_ = nullptr;
+            help_ = false;
+
+            if (argc < 1) {
+                errors_.emplace_back("argument number must be longer than 0");
+                return false;
+            }
+            if (program_name_.empty())
+                program_name_ = argv[0];
+
+            if (argc < 2) {
+                errors_.emplace_back("command is not given");
+                return false;
+            }
+
+            string_ref name(argv[1]);
+            if (name == "help" || name == "--help" || name == "-?") {
+                help_ = true;
+                if (argc < 3)
+                    return true;
+                name = string_ref(argv[2]);
+                if (!(chosen_ = route(name))) {
+                    undefined(name);
+                    return false;
+                }
+                build(*chosen_);
+                return true;
+            }
+
+            if (!(chosen_ = route(name))) {
+                undefined(name);
+                return false;
+            }
+            return build(*chosen_).parse(argc - 1, argv + 1, result_);
+        }
+
+        // parses and exits with the usage of the chosen command (or of all
+        // commands) on errors or when help is asked for
+        void parse_check(int argc, char *argv[])
+        {
+            bool ok = parse(argc, argv);
+            // --help wins over errors such as a missing required option
+            if (help_ || (argc == 1 && !ok) || (chosen_ && result_.exist("help"))) {
+                std::cerr << usage();
+                exit(0);
+            }
+            if (!ok) {
+                std::cerr << error() << std::endl << usage();
+                exit(1);
+            }
+        }
+
+        // name of the chosen command, or "" before a successful routing
+        std::string command() const { return chosen_ ? chosen_->name : std::string(); }
+
+        // schema and result of the chosen command
+        const cmdline::schema &schema() const { return *chosen()->schema; }
+        const parse_result &result() const { return result_; }
+
+        bool exist(const std::string &name) const { return result_.exist(name); }
+
+        template <class T>
+        const T &get(const std::string &name) const { return result_.get<T>(name); }
+
+        const std::vector<std::string> &rest() const { return result_.rest(); }
+
+        std::string error() const { return errors_.empty() ? result_.error() : errors_[0]; }
+
+        std::string error_full() const
+        {
+            std::string ret;
+            for (auto &err : errors_)
+                ret += err + "\n";
+            return errors_.empty() ? result_.error_full() : ret;
+        }
+
+        // usage of the chosen command, or the list of commands
+        std::string usage() const
+        {
+            if (chosen_)
+                return chosen_->schema->usage(program_name_ + " " + chosen_->name);
+
+            size_t max_width = 0;
+            for (auto &c : commands_)
+                max_width = std::max(max_width, c.name.size());
+
+            std::string out = "usage: " + program_name_ + " <command> [options] ... \n";
+            out += "commands:\n";
+            for (auto &c : commands_)
+            {
+                out += "  ";
+                out += c.name;
+                out.append(max_width + 4 - c.name.size(), ' ');
+                out += c.summary;
+                out += '\n';
+            }
+            out += '\n';
+            out += "run '" + program_name_ + " help <command>' for the options of a command\n";
+            if (!footer_.empty())
+                out += footer_ + "\n";
+            return out;
+        }
+
+        // usage of one command, building its schema if needed
+        std::string usage(const std::string &name)
+        {
+            entry *c = route(name);
+            if (!c)
+                throw cmdline_error("undefined command: " + name);
+            return build(*c).usage(program_name_ + " " + c->name);
+        }
+
+    private:
+        struct entry
+        {
+            std::string name;
+            std::string summary;
+            factory make;
+            std::unique_ptr<cmdline::schema> schema;
+        };
+
+        static bool entry_less(const entry &a, const entry &b) { return a.name < b.name; }
+        static bool name_less(const entry &c, string_ref name) { return string_ref(c.name) < name; }
+
+        entry *route(string_ref name)
+        {
+            auto it = std::lower_bound(commands_.begin(), commands_.end(), name, name_less);
+            return it != commands_.end() && string_ref(it->name) == name ? &*it : nullptr;
+        }
+
+        cmdline::schema &build(entry &c)
+        {
+            if (!c.schema) {
+                std::unique_ptr<cmdline::schema> s(new cmdline::schema);
+                c.make(*s);
+                if (!s->find("help"))
+                    s->add("help", '?', "print this message");
+                c.schema = std::move(s);
+            }
+            return *c.schema;
+        }
+
+        void undefined(string_ref name)
+        {
+            detail::suggestions close(name);
+            for (auto &c : commands_)
+                close.offer(c.name);
+            errors_.push_back(std::string("undefined command: ") + name + close.text(""));
+        }
+
+        const entry *chosen() const
+        {
+            if (!chosen_)
+                throw cmdline_error("no command was chosen");
+            return chosen_;
+        }
+
+        // sorted by name
+        std::vector<entry> commands_;
+        entry *chosen_ = nullptr;
+        bool help_ = false;
+        std::string program_name_;
+        std::string footer_;
+        std::vector<std::string> errors_;
+        parse_result result_;
+    };
+}
@@ -0,0 +1,150 @@
+/*
+  Copyright (c) 2009-2019, Hideyuki Tanaka, Joel
+  All rights reserved.
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+  * Neither the name of the <organization> nor the
+  names of its contributors may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+  THIS SOFTWARE IS PROVIDED BY <copyright holder> ''AS IS'' AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <cctype>
+#include <cstring>
+
+#include "schema.hpp"
+#include "string_ref.hpp"
+
+namespace cmdline
+{
+    enum class shell
+    {
+        bash,
+        zsh,
+        fish
+    };
+
+    namespace detail {
+        // program as a shell function name: "my-tool" becomes "my_tool"
+        inline std::string function_name(const std::string &program)
+        {
+            std::string ret = "_cmdline_";
+            for (char c : program)
+                ret += (std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+            return ret;
+        }
+    }
+
+    // a completion script for program that asks program itself for the
+    // candidates, through "program __complete <words>" (see
+    // handle_completion()). load it with e.g.
+    //
+    //   source <(program __completion bash)
+    //
+    // where nothing matches, bash and zsh fall back to file names.
+    inline std::string completion_script(shell sh, const std::string &program)
+    {
+        const std::string fn = detail::function_name(program);
+        switch (sh)
+        {
+            case shell::bash:
+                return fn + "() {\n"
+                       "    local IFS=$'\\n'\n"
+                       "    COMPREPLY=($(\"${COMP_WORDS[0]}\" __complete \"${COMP_WORDS[@]:1:COMP_CWORD}\" 2>/dev/null))\n"
+                       "}\n"
+                       "complete -o default -F " + fn + " " + program + "\n";
+            case shell::zsh:
+                return "#compdef " + program + "\n" +
+                       fn + "() {\n"
+                       "    local -a candidates\n"
+                       "    candidates=(${(f)\"$(${words[1]} __complete \"${(@)words[2,CURRENT]}\" 2>/dev/null)\"})\n"
+                       "    if (( ${#candidates} )); then\n"
+                       "        compadd -- \"${(@)candidates}\"\n"
+                       "    else\n"
+                       "        _files\n"
+                       "    fi\n"
+                       "}\n"
+                       "compdef " + fn + " " + program + "\n";
+            case shell::fish:
+                return "function " + fn + "\n"
+                       "    set -l words (commandline -opc)\n"
+                       "    set -l cmd $words[1]\n"
+                       "    set -e words[1]\n"
+                       "    set -l current (commandline -ct)\n"
+                       "    $cmd __complete $words \"$current\" 2>/dev/null\n"
+                       "end\n"
+                       "complete -c " + program + " -a '(" + fn + ")'\n";
+        }
+        return std::string();
+    }
+
+    // the hidden completion mode. call it in main() as soon as the schema
+    // is built, before the rest of the program starts:
+    //
+    //   if (cmdline::handle_completion(schema, argc, argv))
+    //       return 0;
+    //
+    // "program __complete <words>" prints the completions of the last
+    // word, one per line, and "program __completion bash|zsh|fish" prints
+    // the completion script (or, for an unknown shell, an error to standard
+    // error). returns false, printing nothing, for any other command line.
+    inline bool handle_completion(const schema &s, int argc, const char * const argv[], std::ostream &os = std::cout)
+    {
+        if (argc < 2)
+            return false;
+
+        if (std::strcmp(argv[1], "__complete") == 0) {
+            std::vector<string_ref> words(argv + 2, argv + argc);
+            if (words.empty())
+                words.push_back(string_ref());
+            std::vector<std::string> candidates;
+            s.complete(words, candidates);
+            std::string out;
+            for (auto &c : candidates)
+            {
+                out += c;
+                out += '\n';
+            }
+            os << out;
+            os.flush();
+            return true;
+        }
+
+        if (std::strcmp(argv[1], "__completion") == 0 && argc == 3) {
+            string_ref name(argv[0]);
+            size_t slash = name.rfind('/');
+            std::string program(slash == string_ref::npos ? name : name.substr(slash + 1));
+            string_ref sh(argv[2]);
+            if (sh == "bash")
+                os << completion_script(shell::bash, program);
+            else if (sh == "zsh")
+                os << completion_script(shell::zsh, program);
+            else if (sh == "fish")
+                os << completion_script(shell::fish, program);
+            else
+                std::cerr << "unknown shell: " << sh << " (bash, zsh or fish)" << std::endl;
+            return true;
+        }
+        return false;
+    }
+}
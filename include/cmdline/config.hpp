@@ -0,0 +1,105 @@
+/*
+  Copyright (c) 2009-2019, Hideyuki Tanaka, Joel
+  All rights reserved.
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+  * Neither the name of the <organization> nor the
+  names of its contributors may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+  THIS SOFTWARE IS PROVIDED BY <copyright holder> ''AS IS'' AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <cstring>
+
+#include "string_ref.hpp"
+
+namespace cmdline { namespace detail {
+    // reads the entries of an INI style config file: "key = value" lines,
+    // "[section]" headers and comment lines starting with '#' or ';'.
+    // keys and values are trimmed views into the buffer, a value in double
+    // quotes loses them.
+    class config_reader
+    {
+    public:
+        enum status { entry, malformed, end };
+
+        explicit config_reader(string_ref buf) : p_(buf.begin()), last_(buf.end())
+        {
+            // UTF-8 byte order mark
+            if (buf.starts_with("\xEF\xBB\xBF"))
+                p_ += 3;
+        }
+
+        status next(string_ref &section, string_ref &key, string_ref &value)
+        {
+            while (p_ != last_)
+            {
+                const char *eol = static_cast<const char*>(std::memchr(p_, '\n', static_cast<size_t>(last_ - p_)));
+                if (!eol)
+                    eol = last_;
+                string_ref line = trim(string_ref(p_, static_cast<size_t>(eol - p_)));
+                p_ = eol == last_ ? last_ : eol + 1;
+                ++line_;
+
+                if (line.empty() || line[0] == '#' || line[0] == ';')
+                    continue;
+
+                if (line[0] == '[') {
+                    if (line[line.size() - 1] != ']')
+                        return malformed;
+                    section_ = trim(line.substr(1, line.size() - 2));
+                    continue;
+                }
+
+                size_t eq = line.find('=');
+                if (eq == string_ref::npos || eq == 0)
+                    return malformed;
+
+                section = section_;
+                key = trim(line.substr(0, eq));
+                value = trim(line.substr(eq + 1));
+                if (value.size() >= 2 && value[0] == '"' && value[value.size() - 1] == '"')
+                    value = value.substr(1, value.size() - 2);
+                return entry;
+            }
+            return end;
+        }
+
+        // line number of the last entry
+        size_t line() const { return line_; }
+
+    private:
+        static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v'; }
+
+        static string_ref trim(string_ref s)
+        {
+            const char *b = s.begin(), *e = s.end();
+            while (b != e && is_space(*b))
+                ++b;
+            while (e != b && is_space(e[-1]))
+                --e;
+            return string_ref(b, static_cast<size_t>(e - b));
+        }
+
+        const char *p_;
+        const char *last_;
+        string_ref section_;
+        size_t line_ = 0;
+    };
+} }
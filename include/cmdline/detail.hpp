@@ -27,14 +27,50 @@
 
 #include <string>
 #include <sstream>
+#include <typeinfo>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #ifdef __GNUC__
 #include <cxxabi.h>
 #endif
 
+#include "charconv.hpp"
 #include "error.hpp"
+#include "string_ref.hpp"
 
 namespace cmdline { namespace detail {
+    // numbers are converted in place, only the stream fallback needs a copy
+    template <typename Target>
+    bool read_value(string_ref arg, Target &out, std::true_type)
+    {
+        from_chars_result r = cmdline::from_chars(arg.begin(), arg.end(), out);
+        return r.ec == std::errc() && r.ptr == arg.end();
+    }
+
+    // user types still go through their operator>>
+    template <typename Target>
+    bool read_value(string_ref arg, Target &out, std::false_type)
+    {
+        std::istringstream ss{std::string(arg)};
+        return static_cast<bool>(ss >> out) && ss.eof();
+    }
+
+    // the conversion of lexical_cast from a string, without exceptions.
+    // out may be changed even if arg turns out not to be a T.
+    template <typename Target>
+    bool read_value(string_ref arg, Target &out)
+    {
+        return read_value(arg, out, is_numeric<Target>());
+    }
+
+    inline bool read_value(string_ref arg, std::string &out)
+    {
+        out.assign(arg.data(), arg.size());
+        return true;
+    }
+
     template <typename Target, typename Source, bool Same>
     class lexical_cast_t
     {
@@ -73,10 +109,14 @@ namespace cmdline { namespace detail {
     {
     public:
         static Target cast(const std::string &arg)
+        {
+            return cast(string_ref(arg));
+        }
+
+        static Target cast(string_ref arg)
         {
             Target ret;
-            std::istringstream ss(arg);
-            if (!(ss>>ret && ss.eof()))
+            if (!read_value(arg, ret))
                 throw std::bad_cast();
             return ret;
         }
@@ -88,12 +128,37 @@ namespace cmdline { namespace detail {
     template <typename T>
     struct is_same<T, T>{ static const bool value = true; };
 
+    // whether two T can be compared with <
+    template <typename T>
+    struct less_comparable
+    {
+        template <typename U>
+        static auto test(int) -> decltype(void(std::declval<const U&>() < std::declval<const U&>()), std::true_type());
+        template <typename U>
+        static std::false_type test(...);
+
+        typedef decltype(test<T>(0)) type;
+        static const bool value = type::value;
+    };
+
     template<typename Target, typename Source>
     Target lexical_cast(const Source &arg)
     {
         return lexical_cast_t<Target, Source, detail::is_same<Target, Source>::value>::cast(arg);
     }
 
+    template <typename Target>
+    Target lexical_cast(string_ref arg)
+    {
+        return lexical_cast_t<Target, std::string, detail::is_same<Target, std::string>::value>::cast(arg);
+    }
+
+    template <>
+    inline std::string lexical_cast<std::string>(string_ref arg)
+    {
+        return std::string(arg);
+    }
+
     static inline std::string demangle(const std::string &name)
     {
 #ifdef __GNUC__
@@ -122,10 +187,44 @@ namespace cmdline { namespace detail {
 #endif
     }
 
+    // the name usage() shows for T. common types are named here; others
+    // are demangled once, on first use.
+    template <class T>
+    struct type_name
+    {
+        static const char *get()
+        {
+            static const std::string name = demangle(typeid(T).name());
+            return name.c_str();
+        }
+    };
+
+#define CMDLINE_TYPE_NAME(type, text) \
+    template <> struct type_name<type> { static const char *get() { return text; } };
+
+    CMDLINE_TYPE_NAME(bool, "bool")
+    CMDLINE_TYPE_NAME(char, "char")
+    CMDLINE_TYPE_NAME(signed char, "signed char")
+    CMDLINE_TYPE_NAME(unsigned char, "unsigned char")
+    CMDLINE_TYPE_NAME(short, "short")
+    CMDLINE_TYPE_NAME(unsigned short, "unsigned short")
+    CMDLINE_TYPE_NAME(int, "int")
+    CMDLINE_TYPE_NAME(unsigned int, "unsigned int")
+    CMDLINE_TYPE_NAME(long, "long")
+    CMDLINE_TYPE_NAME(unsigned long, "unsigned long")
+    CMDLINE_TYPE_NAME(long long, "long long")
+    CMDLINE_TYPE_NAME(unsigned long long, "unsigned long long")
+    CMDLINE_TYPE_NAME(float, "float")
+    CMDLINE_TYPE_NAME(double, "double")
+    CMDLINE_TYPE_NAME(long double, "long double")
+    CMDLINE_TYPE_NAME(std::string, "string")
+
+#undef CMDLINE_TYPE_NAME
+
     template <class T>
     std::string readable_typename()
     {
-        return demangle(typeid(T).name());
+        return type_name<T>::get();
     }
 
     template <class T>
@@ -134,9 +233,23 @@ namespace cmdline { namespace detail {
         return detail::lexical_cast<std::string>(def);
     }
 
-    template <>
-    inline std::string readable_typename<std::string>()
+    template <class T>
+    std::string default_value(const std::vector<T> &def)
+    {
+        std::string ret;
+        for (auto &v : def)
+        {
+            if (!ret.empty())
+                ret += ',';
+            ret += detail::lexical_cast<std::string>(v);
+        }
+        return ret;
+    }
+
+    // whether a value given to a flag outside the command line (in the
+    // environment or a config file) turns it on
+    inline bool flag_enabled(string_ref value)
     {
-        return "string";
+        return !value.empty() && value != "0" && value != "false" && value != "no" && value != "off";
     }
 } }
\ No newline at end of file
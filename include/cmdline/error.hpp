@@ -26,6 +26,8 @@
 #pragma once
 
 #include <exception>
+#include <stdexcept>
+#include <type_traits>
 #include <string>
 
 namespace cmdline
@@ -44,4 +46,25 @@ namespace cmdline
     // https://wiki.sei.cmu.edu/confluence/display/cplusplus/ERR60-CPP.+Exception+objects+must+be+nothrow+copy+constructible
     static_assert(std::is_nothrow_copy_constructible<cmdline_error>::value,
             "cmdline_error must be nothrow copy constructible");
-}
\ No newline at end of file
+
+    // what went wrong in a parse. parse_result keeps errors as these codes
+    // and the text they refer to, and only builds messages in error().
+    enum class parse_error
+    {
+        none,
+        no_arguments,
+        syntax_error,
+        response_file_too_deep,
+        cannot_open_response_file,
+        undefined_option,
+        ambiguous_option,
+        undefined_short_option,
+        option_needs_value,
+        invalid_value,
+        invalid_environment_value,
+        need_option,
+        cannot_open_config_file,
+        config_syntax_error,
+        invalid_config_value
+    };
+}
@@ -0,0 +1,317 @@
+/*
+  Copyright (c) 2009-2019, Hideyuki Tanaka, Joel
+  All rights reserved.
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+  * Neither the name of the <organization> nor the
+  names of its contributors may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+  THIS SOFTWARE IS PROVIDED BY <copyright holder> ''AS IS'' AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+
+#include "error.hpp"
+#include "options.hpp"
+#include "string_ref.hpp"
+
+// parse() only counts and times itself when CMDLINE_ENABLE_INSTRUMENTATION
+// is defined. it changes the layout of parse_result, so define it for the
+// whole program (the CMDLINE_ENABLE_INSTRUMENTATION cmake option does)
+// or not at all. without it the hooks below expand to nothing.
+#if defined(CMDLINE_ENABLE_INSTRUMENTATION)
+#define CMDLINE_PROBE(result, call) ((result).probe_.call)
+#else
+#define CMDLINE_PROBE(result, call) ((void)0)
+#endif
+
+namespace cmdline
+{
+    namespace detail { class probe; }
+
+    // the steps of a parse, timed separately
+    enum class parse_phase
+    {
+        tokenize,   // splitting strings and response files into arguments
+        resolve,    // looking names up
+        convert,    // running readers
+        sources,    // environment variables and config files
+        check       // looking for missing required options
+    };
+
+    // where the value of an option came from
+    enum class value_source
+    {
+        command_line,
+        environment,
+        config_file
+    };
+
+    // an option given a value (or set, for flags) during a parse
+    struct trace_event
+    {
+        const option::option_base *option;
+        string_ref value;
+        value_source source;
+        // false if the reader rejected value
+        bool accepted;
+    };
+
+    struct option_stats
+    {
+        string_ref name;
+        unsigned long hits;
+        // values the reader rejected
+        unsigned long rejections;
+    };
+
+    // a copy of the counters of an instrumentation
+    struct parse_stats
+    {
+        static const size_t phase_count = static_cast<size_t>(parse_phase::check) + 1;
+        static const size_t error_count = static_cast<size_t>(parse_error::invalid_config_value) + 1;
+
+        unsigned long parses;
+        unsigned long failures;
+        uint64_t nanoseconds[phase_count];
+        // by parse_error
+        unsigned long errors[error_count];
+        // in the order they were added to the schema
+        std::vector<option_stats> options;
+    };
+
+    // counters, phase timings and an optional trace callback, filled by
+    // every parse into a parse_result it is attached to. an
+    // instrumentation is not synchronized: give each thread its own and
+    // merge() them to report. it refers to the options of the schema it
+    // was used with, so it must not outlive it or be used with another.
+    class instrumentation
+    {
+    public:
+        typedef std::function<void(const trace_event &)> trace_function;
+
+        // whether parse() reports to instrumentations in this build
+#if defined(CMDLINE_ENABLE_INSTRUMENTATION)
+        static const bool enabled = true;
+#else
+        static const bool enabled = false;
+#endif
+
+        instrumentation() { clear(); }
+
+        // called for every option set while parsing, before the parse
+        // goes on
+        void set_trace(trace_function trace) { trace_ = std::move(trace); }
+
+        parse_stats stats() const
+        {
+            parse_stats ret;
+            ret.parses = parses_;
+            ret.failures = failures_;
+            for (size_t i = 0; i < parse_stats::phase_count; i++)
+                ret.nanoseconds[i] = nanoseconds_[i];
+            for (size_t i = 0; i < parse_stats::error_count; i++)
+                ret.errors[i] = errors_[i];
+            ret.options.reserve(options_.size());
+            for (auto &o : options_)
+            {
+                option_stats s = { o.option->name(), o.hits, o.rejections };
+                ret.options.push_back(s);
+            }
+            return ret;
+        }
+
+        // the counters as "<prefix>.<counter> <value>" lines, e.g.
+        // "cmdline.option.port.hits 3"
+        std::string text(const std::string &prefix = "cmdline") const
+        {
+            static const char *const phases[] = { "tokenize", "resolve", "convert", "sources", "check" };
+            static const char *const errors[] = {
+                "none", "no_arguments", "syntax_error", "response_file_too_deep",
+                "cannot_open_response_file", "undefined_option", "ambiguous_option",
+                "undefined_short_option", "option_needs_value", "invalid_value",
+                "invalid_environment_value", "need_option", "cannot_open_config_file",
+                "config_syntax_error", "invalid_config_value"
+            };
+            static_assert(sizeof(phases) / sizeof(phases[0]) == parse_stats::phase_count, "a phase has no name");
+            static_assert(sizeof(errors) / sizeof(errors[0]) == parse_stats::error_count, "an error has no name");
+
+            std::string out;
+            line(out, prefix, "parses", "", parses_);
+            line(out, prefix, "failures", "", failures_);
+            for (size_t i = 0; i < parse_stats::phase_count; i++)
+                line(out, prefix, "phase.", std::string(phases[i]) + ".ns", nanoseconds_[i]);
+            for (size_t i = 1; i < parse_stats::error_count; i++)
+                line(out, prefix, "error.", errors[i], errors_[i]);
+            for (auto &o : options_)
+            {
+                std::string name(o.option->name());
+                line(out, prefix, "option.", name + ".hits", o.hits);
+                line(out, prefix, "option.", name + ".rejections", o.rejections);
+            }
+            return out;
+        }
+
+        // adds the counters of other, which must have been used with the
+        // same schema
+        void merge(const instrumentation &other)
+        {
+            parses_ += other.parses_;
+            failures_ += other.failures_;
+            for (size_t i = 0; i < parse_stats::phase_count; i++)
+                nanoseconds_[i] += other.nanoseconds_[i];
+            for (size_t i = 0; i < parse_stats::error_count; i++)
+                errors_[i] += other.errors_[i];
+            if (options_.size() < other.options_.size())
+                options_.resize(other.options_.size());
+            for (size_t i = 0; i < other.options_.size(); i++)
+            {
+                options_[i].option = other.options_[i].option;
+                options_[i].hits += other.options_[i].hits;
+                options_[i].rejections += other.options_[i].rejections;
+            }
+        }
+
+        // zeroes the counters; the trace callback stays
+        void clear()
+        {
+            parses_ = 0;
+            failures_ = 0;
+            for (auto &n : nanoseconds_)
+                n = 0;
+            for (auto &n : errors_)
+                n = 0;
+            for (auto &o : options_)
+                o.hits = o.rejections = 0;
+        }
+
+    private:
+        friend class detail::probe;
+
+        struct counters
+        {
+            const option::option_base *option = nullptr;
+            unsigned long hits = 0;
+            unsigned long rejections = 0;
+        };
+
+        static void line(std::string &out, const std::string &prefix, const char *group,
+                         const std::string &name, uint64_t value)
+        {
+            out += prefix;
+            out += '.';
+            out += group;
+            out += name;
+            out += ' ';
+            out += std::to_string(value);
+            out += '\n';
+        }
+
+        unsigned long parses_;
+        unsigned long failures_;
+        uint64_t nanoseconds_[parse_stats::phase_count];
+        unsigned long errors_[parse_stats::error_count];
+        std::vector<counters> options_;
+        trace_function trace_;
+    };
+
+    namespace detail {
+        // the side of an instrumentation a parse_result reports to. phases
+        // are timed by reading the clock once per change of phase and
+        // charging the time since the last change to the phase that ends.
+        class probe
+        {
+        public:
+            typedef std::chrono::steady_clock clock;
+
+            void attach(instrumentation *inst) { inst_ = inst; }
+
+            void begin(const std::vector<option::option_base*> &options)
+            {
+                if (!inst_)
+                    return;
+                if (inst_->options_.size() != options.size()) {
+                    inst_->options_.resize(options.size());
+                    for (size_t i = 0; i < options.size(); i++)
+                        inst_->options_[i].option = options[i];
+                }
+                phase_ = parse_phase::tokenize;
+                last_ = clock::now();
+            }
+
+            void enter(parse_phase phase)
+            {
+                if (!inst_ || phase == phase_)
+                    return;
+                charge();
+                phase_ = phase;
+            }
+
+            void set(const option::option_base *opt, string_ref value, value_source source, bool accepted)
+            {
+                if (!inst_)
+                    return;
+                inst_->options_[opt->index()].hits++;
+                if (inst_->trace_) {
+                    trace_event e = { opt, value, source, accepted };
+                    inst_->trace_(e);
+                }
+            }
+
+            void error(parse_error code, const option::option_base *opt)
+            {
+                if (!inst_)
+                    return;
+                inst_->errors_[static_cast<size_t>(code)]++;
+                if (opt && (code == parse_error::invalid_value || code == parse_error::invalid_environment_value ||
+                            code == parse_error::invalid_config_value))
+                    inst_->options_[opt->index()].rejections++;
+            }
+
+            void finish(bool ok)
+            {
+                if (!inst_)
+                    return;
+                charge();
+                inst_->parses_++;
+                if (!ok)
+                    inst_->failures_++;
+            }
+
+        private:
+            void charge()
+            {
+                clock::time_point now = clock::now();
+                inst_->nanoseconds_[static_cast<size_t>(phase_)] +=
+                        static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_).count());
+                last_ = now;
+            }
+
+            instrumentation *inst_ = nullptr;
+            parse_phase phase_ = parse_phase::tokenize;
+            clock::time_point last_;
+        };
+    }
+}
@@ -0,0 +1,409 @@
+/*
+  Copyright (c) 2009-2019, Hideyuki Tanaka, Joel
+  All rights reserved.
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+  * Neither the name of the <organization> nor the
+  names of its contributors may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+  THIS SOFTWARE IS PROVIDED BY <copyright holder> ''AS IS'' AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <cstring>
+
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+#if !defined(_WIN32)
+#include <signal.h>
+#endif
+
+#include "error.hpp"
+#include "schema.hpp"
+#include "string_ref.hpp"
+#include "tokenizer.hpp"
+
+namespace cmdline
+{
+    namespace detail {
+        // number of reload signals received so far, by any live_options
+        inline std::atomic<unsigned> &reload_signals()
+        {
+            static std::atomic<unsigned> count(0);
+            return count;
+        }
+
+        inline void on_reload_signal(int)
+        {
+            reload_signals().fetch_add(1);
+        }
+
+        // modification time, size and inode of a file, to tell whether it
+        // changed
+        struct file_stamp
+        {
+            long long mtime = -1;
+            long long size = -1;
+            long long inode = -1;
+
+            explicit file_stamp(const std::string &path = std::string())
+            {
+                struct stat st;
+                if (path.empty() || ::stat(path.c_str(), &st) != 0)
+                    return;
+#if defined(__linux__)
+                mtime = static_cast<long long>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#else
+                mtime = static_cast<long long>(st.st_mtime);
+#endif
+                size = static_cast<long long>(st.st_size);
+                inode = static_cast<long long>(st.st_ino);
+            }
+
+            bool operator==(const file_stamp &o) const { return mtime == o.mtime && size == o.size && inode == o.inode; }
+            bool operator!=(const file_stamp &o) const { return !(*this == o); }
+        };
+
+        // tells when a file is written or replaced. with inotify the
+        // directory of the file is watched, so that files replaced by a
+        // rename, as editors and config managers do, are seen too; without
+        // it the file is stat()ed on every wait.
+        class file_watch
+        {
+        public:
+            file_watch() = default;
+            file_watch(const file_watch &) = delete;
+            file_watch &operator=(const file_watch &) = delete;
+            ~file_watch() { close(); }
+
+            const std::string &path() const { return path_; }
+
+            // seen is the file as it was when it was read; a change since
+            // then is reported by the next wait()
+            void watch(const std::string &path, const file_stamp &seen)
+            {
+                if (path == path_)
+                    return;
+                close();
+                path_ = path;
+                if (path.empty())
+                    return;
+
+                size_t slash = path.rfind('/');
+                std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+                name_ = slash == std::string::npos ? path : path.substr(slash + 1);
+#if defined(__linux__)
+                fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+                if (fd_ >= 0 && inotify_add_watch(fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE) < 0) {
+                    ::close(fd_);
+                    fd_ = -1;
+                }
+#endif
+                stamp_ = file_stamp(path_);
+                pending_ = stamp_ != seen;
+            }
+
+            // waits up to timeout_ms for the file to change. a signal ends
+            // the wait early where the platform allows.
+            bool wait(int timeout_ms)
+            {
+                if (pending_) {
+                    pending_ = false;
+                    return true;
+                }
+#if defined(__linux__)
+                if (fd_ >= 0) {
+                    pollfd pfd = { fd_, POLLIN, 0 };
+                    if (::poll(&pfd, 1, timeout_ms) <= 0)
+                        return false;
+                    return read_events();
+                }
+                if (timeout_ms > 0)
+                    ::poll(nullptr, 0, timeout_ms);
+#else
+                if (timeout_ms > 0)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+#endif
+                if (path_.empty())
+                    return false;
+                file_stamp now(path_);
+                if (now == stamp_)
+                    return false;
+                stamp_ = now;
+                return true;
+            }
+
+        private:
+#if defined(__linux__)
+            bool read_events()
+            {
+                bool changed = false;
+                alignas(inotify_event) char buf[4096];
+                for (;;)
+                {
+                    ssize_t n = ::read(fd_, buf, sizeof(buf));
+                    if (n <= 0)
+                        return changed;
+                    for (char *p = buf; p < buf + n; )
+                    {
+                        const inotify_event *e = reinterpret_cast<const inotify_event*>(p);
+                        if (e->len && name_ == e->name)
+                            changed = true;
+                        p += sizeof(inotify_event) + e->len;
+                    }
+                }
+            }
+#endif
+
+            void close()
+            {
+#if defined(__linux__)
+                if (fd_ >= 0)
+                    ::close(fd_);
+                fd_ = -1;
+#endif
+                path_.clear();
+                pending_ = false;
+            }
+
+            std::string path_;
+            std::string name_;
+            file_stamp stamp_;
+            bool pending_ = false;
+#if defined(__linux__)
+            int fd_ = -1;
+#endif
+        };
+    }
+
+    // the options of a long-running program, reloaded while it runs. each
+    // successful parse or reload publishes a new immutable snapshot of the
+    // values; reloads whose values do not validate leave the current one.
+    //
+    // read() is wait-free and takes no lock: it pins the current snapshot
+    // by counting itself as a reader of the current epoch. a reload
+    // publishes the new snapshot, then advances the epoch twice and each
+    // time waits for the readers of the previous epoch to leave, after
+    // which no reader can still see the old snapshot and it is freed. a
+    // pinned snapshot never changes, so readers never see a half-updated
+    // configuration.
+    //
+    // parse() and reload() may be called from any thread, poll() from one
+    // thread at a time. options bound to variables with
+    // add(..., T *target) are written by every reload while others read
+    // them, so do not bind options of a live schema.
+    class live_options
+    {
+        struct state
+        {
+            explicit state(const schema &s) : result(s) {}
+            std::vector<std::string> args;
+            parse_result result;
+            unsigned long version = 0;
+        };
+
+    public:
+        // a pinned snapshot. release it soon: reloads wait for it.
+        class snapshot
+        {
+        public:
+            snapshot(snapshot &&o) : state_(o.state_), pin_(o.pin_) { o.pin_ = nullptr; }
+            snapshot(const snapshot &) = delete;
+            snapshot &operator=(const snapshot &) = delete;
+            ~snapshot()
+            {
+                if (pin_)
+                    pin_->fetch_sub(1);
+            }
+
+            const parse_result &operator*() const { return state_->result; }
+            const parse_result *operator->() const { return &state_->result; }
+            // 0 until the first successful parse
+            unsigned long version() const { return state_->version; }
+
+        private:
+            friend class live_options;
+            snapshot(const state *s, std::atomic<long> *pin) : state_(s), pin_(pin) {}
+
+            const state *state_;
+            std::atomic<long> *pin_;
+        };
+
+        // the snapshot read() returns before the first parse has no values
+        explicit live_options(const cmdline::schema &s) : schema_(s), current_(new state(s)) {}
+        live_options(const live_options &) = delete;
+        live_options &operator=(const live_options &) = delete;
+        // all snapshots must have been released
+        ~live_options() { delete current_.load(); }
+
+        snapshot read() const
+        {
+            std::atomic<long> &pin = readers_[epoch_.load() & 1].count;
+            pin.fetch_add(1);
+            return snapshot(current_.load(), &pin);
+        }
+
+        // the first command line. reload() parses it again.
+        bool parse(int argc, const char * const argv[])
+        {
+            return publish(std::vector<std::string>(argv, argv + (argc > 0 ? argc : 0)));
+        }
+
+        // parses the command line of the current snapshot again, which
+        // reads the config file and the environment again
+        bool reload()
+        {
+            std::vector<std::string> args;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                args = current_.load()->args;
+            }
+            return publish(std::move(args));
+        }
+
+        // replaces the command line, e.g. with a line read from a control
+        // pipe: "prog --port 8080", split like schema::parse(const
+        // std::string&)
+        bool reload(const std::string &line)
+        {
+            std::vector<std::string> args;
+            detail::tokenizer tok(line, false);
+            string_ref arg;
+            while (tok.next(arg))
+                args.emplace_back(arg.data(), arg.size());
+            if (tok.error()) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                error_ = tok.error();
+                return false;
+            }
+            return publish(std::move(args));
+        }
+
+        // makes signal sig (e.g. SIGHUP) ask every live_options to reload
+        // in its next poll(). the handler only counts the signal.
+        static bool reload_on_signal(int sig)
+        {
+#if defined(_WIN32)
+            return std::signal(sig, &detail::on_reload_signal) != SIG_ERR;
+#else
+            struct sigaction sa;
+            std::memset(&sa, 0, sizeof(sa));
+            sa.sa_handler = &detail::on_reload_signal;
+            sigemptyset(&sa.sa_mask);
+            return sigaction(sig, &sa, nullptr) == 0;
+#endif
+        }
+
+        // waits up to timeout_ms for the config file to change or a reload
+        // signal, and reloads if either happened. true if a new snapshot
+        // was published; see error() for reloads that were rejected.
+        bool poll(int timeout_ms = 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                watch_.watch(config_path_, config_stamp_);
+            }
+            bool changed = watch_.wait(timeout_ms);
+            unsigned signals = detail::reload_signals().load();
+            if (signals != signals_) {
+                signals_ = signals;
+                changed = true;
+            }
+            return changed && reload();
+        }
+
+        // why the last parse or reload was rejected, empty if it was not
+        std::string error() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return error_;
+        }
+
+        const cmdline::schema &schema() const { return schema_; }
+
+    private:
+        struct padded_counter
+        {
+            std::atomic<long> count{0};
+            // readers of the two epochs do not share a cache line
+            char pad[64 - sizeof(std::atomic<long>)];
+        };
+
+        bool publish(std::vector<std::string> args)
+        {
+            std::unique_ptr<state> next(new state(schema_));
+            next->args = std::move(args);
+            bool ok = schema_.parse(next->args, next->result) && next->result.validate_all();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!ok) {
+                error_ = next->result.error_full();
+                return false;
+            }
+            error_.clear();
+
+            // fill what parse_result computes on first use, so readers
+            // only ever read it
+            next->result.rest();
+            next->result.rest_view();
+            next->version = current_.load()->version + 1;
+
+            if (const option::option_with_value<std::string> *config = schema_.config_option()) {
+                config_path_ = config->get(next->result.values());
+                config_stamp_ = detail::file_stamp(config_path_);
+            }
+
+            const state *old = current_.exchange(next.release());
+            for (int i = 0; i < 2; i++)
+            {
+                unsigned epoch = epoch_.fetch_add(1);
+                while (readers_[epoch & 1].count.load() != 0)
+                    std::this_thread::yield();
+            }
+            delete old;
+            return true;
+        }
+
+        const cmdline::schema &schema_;
+        std::atomic<const state*> current_;
+        std::atomic<unsigned> epoch_{0};
+        mutable padded_counter readers_[2];
+        // serializes writers
+        mutable std::mutex mutex_;
+        std::string error_;
+        // the config file of the current snapshot, which poll() watches
+        std::string config_path_;
+        detail::file_stamp config_stamp_;
+        detail::file_watch watch_;
+        unsigned signals_ = 0;
+    };
+}
@@ -0,0 +1,117 @@
+/*
+  Copyright (c) 2009-2019, Hideyuki Tanaka, Joel
+  All rights reserved.
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+  * Neither the name of the <organization> nor the
+  names of its contributors may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+  THIS SOFTWARE IS PROVIDED BY <copyright holder> ''AS IS'' AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <string>
+
+#if defined(_WIN32)
+#include <fstream>
+#include <iterator>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "string_ref.hpp"
+
+namespace cmdline { namespace detail {
+    // read-only view of a whole file. the file is memory mapped where mmap
+    // is available and read into memory otherwise.
+    class mapped_file
+    {
+    public:
+        mapped_file() = default;
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+        ~mapped_file() { close(); }
+
+        bool open(const std::string &path)
+        {
+            close();
+#if defined(_WIN32)
+            std::ifstream ifs(path.c_str(), std::ios::binary);
+            if (!ifs)
+                return false;
+            buffer_.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+            data_ = buffer_.data();
+            size_ = buffer_.size();
+            return true;
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+                ::close(fd);
+                return false;
+            }
+
+            size_ = static_cast<size_t>(st.st_size);
+            if (size_ > 0) {
+                void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p == MAP_FAILED) {
+                    ::close(fd);
+                    size_ = 0;
+                    return false;
+                }
+#if defined(MADV_SEQUENTIAL)
+                madvise(p, size_, MADV_SEQUENTIAL);
+#endif
+                data_ = static_cast<const char*>(p);
+            }
+            ::close(fd);
+            return true;
+#endif
+        }
+
+        void close()
+        {
+#if defined(_WIN32)
+            buffer_.clear();
+#else
+            if (size_ > 0)
+                munmap(const_cast<char*>(data_), size_);
+#endif
+            data_ = "";
+            size_ = 0;
+        }
+
+        const char *data() const { return data_; }
+        size_t size() const { return size_; }
+        string_ref view() const { return string_ref(data_, size_); }
+
+    private:
+        const char *data_ = "";
+        size_t size_ = 0;
+#if defined(_WIN32)
+        std::vector<char> buffer_;
+#endif
+    };
+} }
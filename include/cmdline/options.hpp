@@ -25,139 +25,655 @@
 
 #pragma once
 
+#include <memory>
+#include <new>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstring>
 
 #include "detail.hpp"
+#include "error.hpp"
+#include "reader.hpp"
+#include "string_ref.hpp"
 
 namespace cmdline { namespace option {
+    // per-parse state of the options of a schema: whether each option was
+    // set, its raw text and its converted value. values live in one buffer
+    // laid out by the schema and are constructed on first use.
+    //
+    // reset() is O(1): an option counts as set only if its slot carries the
+    // current generation.
+    //
+    // in lazy mode options only record their raw text when set and convert
+    // it on first read, so reading a lazy store is not thread-safe.
+    class value_store
+    {
+    public:
+        value_store() = default;
+        value_store(const value_store &) = delete;
+        value_store &operator=(const value_store &) = delete;
+        ~value_store() { clear(); }
+
+        // make room for a schema with the given number of options and bytes
+        // of values, and forget the previous parse. the values are only
+        // kept for reuse if the layout is the same one (same_schema).
+        void bind(size_t slots, size_t bytes, bool same_schema = true)
+        {
+            if (!same_schema || slots != slots_.size() || bytes > storage_.size() * sizeof(std::max_align_t)) {
+                clear();
+                slots_.resize(slots);
+                storage_.resize((bytes + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t));
+            }
+            reset();
+        }
+
+        void reset()
+        {
+            if (++generation_ == 0) {
+                for (auto &s : slots_)
+                    s.generation = s.converted = 0;
+                generation_ = 1;
+            }
+        }
+
+        bool has(size_t i) const { return i < slots_.size() && slots_[i].generation == generation_; }
+        bool converted(size_t i) const { return i < slots_.size() && slots_[i].converted == generation_; }
+        string_ref raw(size_t i) const { return has(i) ? slots_[i].raw : string_ref(); }
+
+        void mark(size_t i, string_ref raw)
+        {
+            slots_[i].generation = generation_;
+            slots_[i].raw = raw;
+        }
+
+        template <class T>
+        const T *get(size_t i, size_t offset) const
+        {
+            return converted(i) ? reinterpret_cast<const T*>(data() + offset) : nullptr;
+        }
+
+        template <class T>
+        void assign(size_t i, size_t offset, T &&value, string_ref raw)
+        {
+            slot &s = slots_[i];
+            void *p = data() + offset;
+            if (s.destroy) {
+                *static_cast<T*>(p) = std::move(value);
+            } else {
+                new (p) T(std::move(value));
+                s.destroy = &destroy<T>;
+                s.offset = offset;
+            }
+            mark_converted(i, raw);
+        }
+
+        // the value in slot i, whether or not it is set, for options that
+        // update it in place. it is default constructed on first use.
+        template <class T>
+        T &value(size_t i, size_t offset)
+        {
+            slot &s = slots_[i];
+            void *p = data() + offset;
+            if (!s.destroy) {
+                new (p) T();
+                s.destroy = &destroy<T>;
+                s.offset = offset;
+            }
+            return *static_cast<T*>(p);
+        }
+
+        void mark_converted(size_t i, string_ref raw)
+        {
+            mark(i, raw);
+            slots_[i].converted = generation_;
+        }
+
+        void set_lazy(bool lazy) { lazy_ = lazy; }
+        bool lazy() const { return lazy_; }
+
+    private:
+        struct slot
+        {
+            unsigned generation = 0;
+            unsigned converted = 0;
+            string_ref raw;
+            void (*destroy)(void *) = nullptr;
+            size_t offset = 0;
+        };
+
+        template <class T>
+        static void destroy(void *p) { static_cast<T*>(p)->~T(); }
+
+        char *data() { return reinterpret_cast<char*>(storage_.data()); }
+        const char *data() const { return reinterpret_cast<const char*>(storage_.data()); }
+
+        void clear()
+        {
+            for (auto &s : slots_)
+                if (s.destroy) {
+                    s.destroy(data() + s.offset);
+                    s.destroy = nullptr;
+                }
+        }
+
+        std::vector<slot> slots_;
+        std::vector<std::max_align_t> storage_;
+        unsigned generation_ = 0;
+        bool lazy_ = false;
+    };
+
+    // an option definition. it holds no parse state, all of that goes to
+    // the value_store passed in, so one definition can serve any number of
+    // concurrent parses. names and descriptions are views into the string
+    // pool of the schema that owns the option; the text usage() shows for
+    // an option is only put together by describe().
     class option_base
     {
     public:
+        option_base(string_ref name, char short_name, string_ref desc)
+                : name_(name), desc_(desc), short_name_(short_name) {}
         virtual ~option_base() = default;
         virtual bool has_value() const = 0;
-        virtual bool set() = 0;
-        virtual bool set(const std::string &value) = 0;
-        virtual bool has_set() const = 0;
-        virtual bool valid() const = 0;
+        virtual bool set(value_store &store) const = 0;
+        virtual bool set(value_store &store, string_ref value) const = 0;
         virtual bool must() const = 0;
-        virtual const std::string &name() const = 0;
-        virtual char short_name() const = 0;
-        virtual const std::string &description() const = 0;
         virtual std::string short_description() const = 0;
+        // appends the description with the type and default of the value
+        virtual void describe(std::string &out) const { out.append(desc_.data(), desc_.size()); }
+        // converts a value left raw by a lazy parse
+        virtual bool validate(value_store &) const { return true; }
+        // appends the values starting with prefix the option accepts, if
+        // its reader has a set of them
+        virtual void complete(string_ref, std::vector<std::string> &) const {}
+        // options bound to a variable of the caller put its default back
+        // when a parse leaves them unset
+        virtual void restore_default() const {}
+        virtual size_t value_size() const { return 0; }
+        virtual size_t value_align() const { return 1; }
+
+        string_ref name() const { return name_; }
+        char short_name() const { return short_name_; }
+        // the description given to add()
+        string_ref description() const { return desc_; }
+
+        bool has_set(const value_store &store) const { return store.has(index_); }
+        bool valid(const value_store &store) const { return !(must() && !has_set(store)); }
+        string_ref raw(const value_store &store) const { return store.raw(index_); }
+
+        // position of the option's slot and value, assigned by the schema
+        size_t index() const { return index_; }
+        size_t offset() const { return offset_; }
+        void place(size_t index, size_t offset)
+        {
+            index_ = index;
+            offset_ = offset;
+        }
+
+    protected:
+        string_ref name_;
+        string_ref desc_;
+        char short_name_;
+        size_t index_ = 0;
+        size_t offset_ = 0;
     };
 
     class option_without_value : public option_base
     {
     public:
-        option_without_value(const std::string &name,
-                             char short_name,
-                             const std::string &desc)
-        {
-            name_ = name;
-            short_name_ = short_name;
-            desc_ = desc;
-            has_ = false;
-        }
+        option_without_value(string_ref name, char short_name, string_ref desc)
+                : option_base(name, short_name, desc) {}
 
         ~option_without_value() override = default;
-        bool set() override
+        bool set(value_store &store) const override
         {
-            has_ = true;
+            store.mark(index_, string_ref());
             return true;
         }
         bool has_value() const override { return false; }
-        bool set(const std::string &) override { return false; }
-        bool has_set() const override { return has_; }
-        bool valid() const override {return true; }
+        bool set(value_store &, string_ref) const override { return false; }
         bool must() const override { return false; }
-        const std::string &name() const override { return name_; }
-        char short_name() const override { return short_name_; }
-        const std::string &description() const override { return desc_; }
-        std::string short_description() const override { return "--" + name_; }
-
-    protected:
-        std::string name_;
-        char short_name_;
-        std::string desc_;
-        bool has_;
+        std::string short_description() const override { return "--" + std::string(name_); }
     };
 
     template <class T>
     class option_with_value : public option_base
     {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned option types are not supported");
+
     public:
-        option_with_value(const std::string &name, char short_name,
-                          bool need, const T &def, const std::string &desc)
-        {
+        option_with_value(string_ref name, char short_name, bool need, const T &def, string_ref desc)
+                : option_base(name, short_name, desc), need_(need), def_(def) {}
+        ~option_with_value() override = default;
 
-            name_ = name;
-            short_name_ = short_name;
-            need_ = need;
-            has_ = false;
-            def_ = def;
-            actual_ = def;
-            this->desc_ = full_description(desc);
+        // the value of the last parse into store, or the default. a value
+        // left raw by a lazy parse is converted and kept in store.
+        const T &get(const value_store &store) const
+        {
+            if (bound_)
+                return *bound_;
+            if (const T *p = store.get<T>(index_, offset_))
+                return *p;
+            if (!store.has(index_))
+                return def_;
+            if (!convert(const_cast<value_store&>(store)))
+                throw cmdline_error(std::string("option value is invalid: --") + name_ + "=" + store.raw(index_));
+            return *store.get<T>(index_, offset_);
         }
-        ~option_with_value() override = default;
-        const T &get() const { return actual_; }
 
         bool has_value() const override { return true; }
-        bool set() override { return false;}
-        bool set(const std::string &value) override
+        bool set(value_store &) const override { return false;}
+        bool set(value_store &store, string_ref value) const override
         {
-            try{
-                actual_ = read(value);
-                has_ = true;
-            } catch(const std::exception &e) {
-                return false;
+            if (store.lazy()) {
+                store.mark(index_, value);
+                return true;
             }
-            return true;
+            return store_value(store, value);
+        }
+
+        bool validate(value_store &store) const override
+        {
+            return !store.has(index_) || store.converted(index_) || convert(store);
         }
 
-        bool has_set() const override { return has_; }
-        bool valid() const override { return !(need_ && !has_); }
         bool must() const override { return need_; }
-        const std::string &name() const override { return name_; }
-        char short_name() const override { return short_name_; }
-        const std::string &description() const override { return desc_; }
         std::string short_description() const override
         {
-            return "--" + name_ + "=" + detail::readable_typename<T>();
+            return "--" + std::string(name_) + "=" + detail::type_name<T>::get();
+        }
+        // "desc (type [=default])"
+        void describe(std::string &out) const override
+        {
+            out.append(desc_.data(), desc_.size());
+            out += " (";
+            out += detail::type_name<T>::get();
+            if (!need_) {
+                out += " [=";
+                out += default_text();
+                out += ']';
+            }
+            out += ')';
         }
+        size_t value_size() const override { return sizeof(T); }
+        size_t value_align() const override { return alignof(T); }
 
     protected:
-        std::string full_description(const std::string &desc)
+        bool convert(value_store &store) const
         {
-            return desc+ " (" +detail::readable_typename<T>() +
-                   (need_ ? "" : " [=" + detail::default_value<T>(def_) + "]" ) +")";
+            return store_value(store, store.raw(index_));
         }
 
-        virtual T read(const std::string &s) = 0;
+        const T &default_value() const { return def_; }
+        // the default as usage() shows it
+        virtual std::string default_text() const = 0;
+
+        // converts raw and keeps it as the value of the option in store;
+        // false if raw is invalid
+        virtual bool store_value(value_store &store, string_ref raw) const = 0;
+
+        // the variable of an option_with_target, which get() returns
+        const T *bound_ = nullptr;
 
     private:
-        std::string name_;
-        char short_name_;
         bool need_;
-        std::string desc_;
 
-        bool has_;
         T def_;
-        T actual_;
     };
 
     template <class T, class F>
     class option_with_value_with_reader : public option_with_value<T>
     {
     public:
-        option_with_value_with_reader(const std::string &name, char short_name,
-                                      bool need, const T def, const std::string &desc, F reader)
+        option_with_value_with_reader(string_ref name, char short_name, bool need, const T def,
+                                      string_ref desc, F reader)
                 : option_with_value<T>(name, short_name, need, def, desc), reader(reader) {
         }
 
+        void complete(string_ref prefix, std::vector<std::string> &out) const override
+        {
+            detail::complete_with(reader, prefix, out);
+        }
+
     protected:
-        T read(const std::string &s) override { return reader(s); }
+        std::string default_text() const override { return detail::default_text(reader, this->default_value()); }
+
+        bool store_value(value_store &store, string_ref raw) const override
+        {
+            return store_value(store, raw, typename detail::reads_in_place<F, T>::type());
+        }
+
+    private:
+        // without exceptions. the first value of a parse is read in place,
+        // so a string keeps its capacity from one parse to the next; a
+        // later one goes through a temporary, so that a rejected value
+        // leaves the one before.
+        bool store_value(value_store &store, string_ref raw, std::true_type) const
+        {
+            if (store.converted(this->index_)) {
+                T value = T();
+                if (!reader.read(raw, value))
+                    return false;
+                store.assign<T>(this->index_, this->offset_, std::move(value), raw);
+                return true;
+            }
+            if (!reader.read(raw, store.value<T>(this->index_, this->offset_)))
+                return false;
+            store.mark_converted(this->index_, raw);
+            return true;
+        }
+
+        bool store_value(value_store &store, string_ref raw, std::false_type) const
+        {
+            try{
+                store.assign<T>(this->index_, this->offset_, detail::invoke_reader<T>(reader, raw), raw);
+            } catch(const std::exception &e) {
+                return false;
+            }
+            return true;
+        }
+
+        // readers may have a non-const operator(). a schema shared between
+        // threads calls it concurrently, so it must not modify state.
+        mutable F reader;
+    };
+
+    // a flag bound to a variable of the caller, set to true when given.
+    // a parse without the flag puts back the value *target had when it
+    // was bound.
+    class flag_with_target : public option_without_value
+    {
+    public:
+        flag_with_target(string_ref name, char short_name, bool *target, string_ref desc)
+                : option_without_value(name, short_name, desc), target_(target), def_(*target) {}
+
+        bool set(value_store &store) const override
+        {
+            *target_ = true;
+            return option_without_value::set(store);
+        }
+
+        void restore_default() const override { *target_ = def_; }
+
+    private:
+        bool *target_;
+        bool def_;
+    };
+
+    // an option bound to a variable of the caller, e.g. a member of a
+    // config struct. values are read straight into *target, and the
+    // value_store only records that the option was set, so the option takes
+    // no room in it. the value *target has when it is bound is the default,
+    // which a parse that leaves the option unset puts back. a rejected value
+    // leaves *target as it was.
+    //
+    // values are converted as they are seen, also in lazy mode.
+    template <class T, class F>
+    class option_with_target : public option_with_value<T>
+    {
+    public:
+        option_with_target(string_ref name, char short_name, bool need, T *target, string_ref desc, F reader)
+                : option_with_value<T>(name, short_name, need, *target, desc), target_(target), reader(reader)
+        {
+            this->bound_ = target;
+        }
+
+        bool set(value_store &store, string_ref value) const override { return store_value(store, value); }
+        size_t value_size() const override { return 0; }
+        size_t value_align() const override { return 1; }
+
+        void complete(string_ref prefix, std::vector<std::string> &out) const override
+        {
+            detail::complete_with(reader, prefix, out);
+        }
+
+        void restore_default() const override { *target_ = this->default_value(); }
+
+    protected:
+        std::string default_text() const override { return detail::default_text(reader, this->default_value()); }
+
+        bool store_value(value_store &store, string_ref raw) const override
+        {
+            if (!read(raw, typename detail::reads_in_place<F, T>::type()))
+                return false;
+            store.mark_converted(this->index_, raw);
+            return true;
+        }
+
+    private:
+        bool read(string_ref raw, std::true_type) const
+        {
+            T value = T();
+            if (!reader.read(raw, value))
+                return false;
+            *target_ = std::move(value);
+            return true;
+        }
+
+        bool read(string_ref raw, std::false_type) const
+        {
+            try {
+                *target_ = detail::invoke_reader<T>(reader, raw);
+            } catch (const std::exception &e) {
+                return false;
+            }
+            return true;
+        }
+
+        T *target_;
+        // see option_with_value_with_reader
+        mutable F reader;
+    };
+
+    // an option that can be given many times. every value is appended to a
+    // std::vector<T> kept by the value_store, which is emptied (keeping its
+    // capacity) when a parse sets the option for the first time. with a
+    // delimiter each value is also split into elements, after reserving
+    // room for all of them.
+    //
+    // elements are converted as they are seen, also in lazy mode.
+    template <class T, class F>
+    class option_with_values : public option_with_value<std::vector<T> >
+    {
+        typedef option_with_value<std::vector<T> > base;
+
+    public:
+        option_with_values(string_ref name, char short_name, bool need, char delimiter, string_ref desc, F reader)
+                : base(name, short_name, need, std::vector<T>(), desc), delimiter_(delimiter), reader(reader) {}
+
+        bool set(value_store &store, string_ref value) const override
+        {
+            bool first = !store.has(this->index_);
+            std::vector<T> &v = store.value<std::vector<T> >(this->index_, this->offset_);
+            if (first)
+                v.clear();
+
+            size_t size = v.size();
+            if (!append(v, value)) {
+                v.erase(v.begin() + size, v.end());
+                return false;
+            }
+            store.mark_converted(this->index_, value);
+            return true;
+        }
+
+        std::string short_description() const override
+        {
+            return "--" + std::string(this->name_) + "=" + detail::type_name<T>::get();
+        }
+
+        // with a delimiter the element after the last one is completed:
+        // "a,b,c" offers "a,b,cat" and "a,b,cow"
+        void complete(string_ref prefix, std::vector<std::string> &out) const override
+        {
+            size_t cut = delimiter_ ? prefix.rfind(delimiter_) : string_ref::npos;
+            if (cut == string_ref::npos) {
+                detail::complete_with(reader, prefix, out);
+                return;
+            }
+            size_t first = out.size();
+            detail::complete_with(reader, prefix.substr(cut + 1), out);
+            for (size_t i = first; i < out.size(); i++)
+                out[i].insert(0, prefix.data(), cut + 1);
+        }
+
+        // "desc (type list, separated by ',')"
+        void describe(std::string &out) const override
+        {
+            out.append(this->desc_.data(), this->desc_.size());
+            out += " (";
+            out += detail::type_name<T>::get();
+            out += " list";
+            if (delimiter_) {
+                out += ", separated by '";
+                out += delimiter_;
+                out += '\'';
+            }
+            out += ')';
+        }
+
+    protected:
+        std::string default_text() const override { return std::string(); }
+
+        // lists are converted by set() even in lazy mode, so this only
+        // replaces the whole list
+        bool store_value(value_store &store, string_ref raw) const override
+        {
+            std::vector<T> &v = store.value<std::vector<T> >(this->index_, this->offset_);
+            v.clear();
+            if (!append(v, raw))
+                return false;
+            store.mark_converted(this->index_, raw);
+            return true;
+        }
+
+    private:
+        bool append(std::vector<T> &v, string_ref value) const
+        {
+            if (!delimiter_)
+                return push(v, value);
+
+            const char *p = value.begin(), *last = value.end();
+            size_t n = 1;
+            for (const char *q = p; (q = find_delimiter(q, last)) != last; ++q)
+                ++n;
+            v.reserve(v.size() + n);
+
+            for (;;)
+            {
+                const char *q = find_delimiter(p, last);
+                if (!push(v, string_ref(p, static_cast<size_t>(q - p))))
+                    return false;
+                if (q == last)
+                    return true;
+                p = q + 1;
+            }
+        }
+
+        bool push(std::vector<T> &v, string_ref s) const
+        {
+            return push(v, s, typename detail::reads_in_place<F, T>::type());
+        }
+
+        bool push(std::vector<T> &v, string_ref s, std::true_type) const
+        {
+            v.emplace_back();
+            if (reader.read(s, v.back()))
+                return true;
+            v.pop_back();
+            return false;
+        }
+
+        bool push(std::vector<T> &v, string_ref s, std::false_type) const
+        {
+            try {
+                v.push_back(detail::invoke_reader<T>(reader, s));
+            } catch (const std::exception &e) {
+                return false;
+            }
+            return true;
+        }
+
+        const char *find_delimiter(const char *p, const char *last) const
+        {
+            const void *q = std::memchr(p, delimiter_, static_cast<size_t>(last - p));
+            return q ? static_cast<const char*>(q) : last;
+        }
+
+        char delimiter_;
+        // see option_with_value_with_reader
+        mutable F reader;
+    };
+} }
+
+namespace cmdline
+{
+    // handle to a typed option returned by schema::add<T>(). it reads the
+    // option directly, without a name lookup or a dynamic_cast. a schema is
+    // shared by its results, so the handle is read with get(result.values()).
+    template <class T>
+    class option_handle
+    {
+    public:
+        option_handle() : opt_(nullptr) {}
+        explicit option_handle(const option::option_with_value<T> *opt) : opt_(opt) {}
+
+        const T &get(const option::value_store &store) const { return opt_->get(store); }
+        bool has_set(const option::value_store &store) const { return opt_->has_set(store); }
+        string_ref name() const { return opt_->name(); }
+
+    protected:
+        const option::option_with_value<T> *opt_;
+    };
+
+    // handle returned by parser::add<T>(), bound to the parser's result
+    template <class T>
+    class option_ref : public option_handle<T>
+    {
+    public:
+        option_ref() : store_(nullptr) {}
+        option_ref(const option_handle<T> &h, const option::value_store *store)
+                : option_handle<T>(h), store_(store) {}
+
+        using option_handle<T>::get;
+        using option_handle<T>::has_set;
+        const T &get() const { return this->opt_->get(*store_); }
+        const T &operator*() const { return get(); }
+        const T *operator->() const { return &get(); }
+        bool has_set() const { return this->opt_->has_set(*store_); }
+
+    private:
+        const option::value_store *store_;
+    };
+
+    // handle to a flag returned by schema::add()
+    class flag_handle
+    {
+    public:
+        flag_handle() : opt_(nullptr) {}
+        explicit flag_handle(const option::option_without_value *opt) : opt_(opt) {}
+
+        bool has_set(const option::value_store &store) const { return opt_->has_set(store); }
+        string_ref name() const { return opt_->name(); }
+
+    protected:
+        const option::option_without_value *opt_;
+    };
+
+    // handle to a flag returned by parser::add()
+    class flag_ref : public flag_handle
+    {
+    public:
+        flag_ref() : store_(nullptr) {}
+        flag_ref(const flag_handle &h, const option::value_store *store) : flag_handle(h), store_(store) {}
+
+        using flag_handle::has_set;
+        bool has_set() const { return opt_->has_set(*store_); }
+        explicit operator bool() const { return has_set(); }
 
     private:
-        F reader;
+        const option::value_store *store_;
     };
-} }
\ No newline at end of file
+}
@@ -25,23 +25,60 @@
 
 #pragma once
 
+#include <algorithm>
+#include <exception>
+#include <initializer_list>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+#include <cstdint>
+
+#include "arena.hpp"
 #include "detail.hpp"
+#include "error.hpp"
+#include "string_ref.hpp"
+
+namespace cmdline { namespace detail {
+    // appends the strings of sorted that start with prefix: a binary search
+    // for the first one, then a walk until one does not match
+    inline void complete_sorted(const std::vector<std::string> &sorted, string_ref prefix,
+                                std::vector<std::string> &out)
+    {
+        auto it = std::lower_bound(sorted.begin(), sorted.end(), prefix,
+                                   [](const std::string &a, string_ref b) { return string_ref(a) < b; });
+        for (; it != sorted.end() && string_ref(*it).starts_with(prefix); ++it)
+            out.push_back(*it);
+    }
+} }
 
 namespace cmdline
 {
+    // a reader is called with the text of a value and returns it converted,
+    // throwing if the text is invalid. readers that also have a
+    //
+    //   bool read(string_ref s, T &out) const
+    //
+    // member are used through it instead, which rejects invalid values
+    // without exceptions. all readers below have one. readers of a fixed
+    // set of values can offer them for shell completion with a
+    //
+    //   void complete(string_ref prefix, std::vector<std::string> &out) const
+    //
+    // member, which appends the values starting with prefix.
     template <class T>
     struct default_reader
     {
-        T operator()(const std::string &str) { return detail::lexical_cast<T>(str); }
+        T operator()(string_ref str) const { return detail::lexical_cast<T>(str); }
+        bool read(string_ref str, T &out) const { return detail::read_value(str, out); }
     };
 
     template <class T>
     struct range_reader
     {
-        range_reader(const T &low, const T &high): low(low), high(high) { }
-        T operator()(const std::string &s) const
+        constexpr range_reader(const T &low, const T &high): low(low), high(high) { }
+        T operator()(string_ref s) const
         {
             T ret = default_reader<T>()(s);
             if ( !(ret >= low && ret <= high) ) {
@@ -49,26 +86,438 @@ namespace cmdline
             }
             return ret;
         }
+        // out is only assigned values in range
+        bool read(string_ref s, T &out) const
+        {
+            T value = T();
+            if (!default_reader<T>().read(s, value) || !(value >= low && value <= high))
+                return false;
+            out = std::move(value);
+            return true;
+        }
     private:
         T low;
         T high;
     };
 
     template <class T>
-    range_reader<T> range(const T &low, const T &high) { return range_reader<T>(low, high); }
+    constexpr range_reader<T> range(const T &low, const T &high) { return range_reader<T>(low, high); }
 
+    // accepts the values it holds and nothing else. they are kept sorted,
+    // so checking an argument is a binary search; build large sets with
+    // the range constructor, which sorts them once. types without
+    // operator< are searched one by one.
     template <class T>
     struct one_of_reader
     {
-        T operator()(const std::string &s)
+        one_of_reader() = default;
+
+        template <class It>
+        one_of_reader(It first, It last) : alt(first, last)
+        {
+            sort(typename detail::less_comparable<T>::type());
+        }
+
+        one_of_reader(std::initializer_list<T> values) : one_of_reader(values.begin(), values.end()) {}
+
+        T operator()(string_ref s) const
         {
             T ret=default_reader<T>()(s);
-            if (std::find(alt.begin(), alt.end(), ret) == alt.end())
+            if (!contains(ret))
                 throw cmdline_error("");
             return ret;
         }
-        void add(const T &v){ alt.push_back(v); }
+
+        bool read(string_ref s, T &out) const
+        {
+            T value = T();
+            if (!default_reader<T>().read(s, value) || !contains(value))
+                return false;
+            out = std::move(value);
+            return true;
+        }
+
+        void add(const T &v)
+        {
+            insert(v, typename detail::less_comparable<T>::type());
+            text_.clear();
+        }
+
+        bool contains(const T &v) const { return contains(v, typename detail::less_comparable<T>::type()); }
+
+        // values are formatted and sorted as text on the first completion,
+        // which then searches that index like sets of strings search alt.
+        // building it is not thread-safe, as completion runs once per process.
+        void complete(string_ref prefix, std::vector<std::string> &out) const
+        {
+            if (text_.empty() && !alt.empty()) {
+                text_.reserve(alt.size());
+                for (auto &v : alt)
+                    text_.push_back(detail::default_value(v));
+                std::sort(text_.begin(), text_.end());
+            }
+            detail::complete_sorted(text_, prefix, out);
+        }
+
     private:
+        void sort(std::true_type)
+        {
+            std::sort(alt.begin(), alt.end());
+            alt.erase(std::unique(alt.begin(), alt.end(), [](const T &a, const T &b) { return !(a < b); }), alt.end());
+        }
+        void sort(std::false_type) {}
+
+        void insert(const T &v, std::true_type)
+        {
+            auto it = std::lower_bound(alt.begin(), alt.end(), v);
+            if (it == alt.end() || v < *it)
+                alt.insert(it, v);
+        }
+        void insert(const T &v, std::false_type) { alt.push_back(v); }
+
+        bool contains(const T &v, std::true_type) const { return std::binary_search(alt.begin(), alt.end(), v); }
+        bool contains(const T &v, std::false_type) const { return std::find(alt.begin(), alt.end(), v) != alt.end(); }
+
         std::vector<T> alt;
+        // see complete()
+        mutable std::vector<std::string> text_;
+    };
+
+    // strings are looked up as they are, and only copied once accepted
+    template <>
+    inline bool one_of_reader<std::string>::read(string_ref s, std::string &out) const
+    {
+        auto it = std::lower_bound(alt.begin(), alt.end(), s,
+                                   [](const std::string &a, string_ref b) { return string_ref(a) < b; });
+        if (it == alt.end() || string_ref(*it) != s)
+            return false;
+        out = *it;
+        return true;
+    }
+
+    template <>
+    inline void one_of_reader<std::string>::complete(string_ref prefix, std::vector<std::string> &out) const
+    {
+        detail::complete_sorted(alt, prefix, out);
+    }
+
+    template <>
+    inline std::string one_of_reader<std::string>::operator()(string_ref s) const
+    {
+        std::string ret;
+        if (!read(s, ret))
+            throw cmdline_error("");
+        return ret;
+    }
+
+    // maps names straight to values, usually of an enum:
+    //
+    //   cmdline::enum_reader<color>({{"red", color::red}, {"green", color::green}})
+    //
+    // the names go into a perfect hash table when the reader is built, so
+    // reading an argument hashes it once and compares it with one name.
+    // usage() shows the default by its name.
+    template <class T>
+    class enum_reader
+    {
+    public:
+        template <class It>
+        enum_reader(It first, It last)
+        {
+            for (; first != last; ++first)
+                entries_.push_back(entry{std::string(first->first), first->second});
+            build();
+        }
+
+        enum_reader(std::initializer_list<std::pair<const char*, T> > values)
+                : enum_reader(values.begin(), values.end()) {}
+
+        T operator()(string_ref s) const
+        {
+            const entry *e = find(s);
+            if (!e)
+                throw cmdline_error(std::string("undefined value: ") + s);
+            return e->value;
+        }
+
+        bool read(string_ref s, T &out) const
+        {
+            const entry *e = find(s);
+            if (e)
+                out = e->value;
+            return e != nullptr;
+        }
+
+        // name of v, or "" if v has none
+        std::string name(const T &v) const
+        {
+            for (auto &e : entries_)
+            {
+                if (e.value == v)
+                    return e.name;
+            }
+            return std::string();
+        }
+
+        size_t size() const { return entries_.size(); }
+
+        // the names are only hashed when the reader is built; the first
+        // completion sorts a copy of them and searches it from then on.
+        // building it is not thread-safe, as completion runs once per process.
+        void complete(string_ref prefix, std::vector<std::string> &out) const
+        {
+            if (sorted_.empty() && !entries_.empty()) {
+                sorted_.reserve(entries_.size());
+                for (auto &e : entries_)
+                    sorted_.push_back(e.name);
+                std::sort(sorted_.begin(), sorted_.end());
+            }
+            detail::complete_sorted(sorted_, prefix, out);
+        }
+
+    private:
+        struct entry
+        {
+            std::string name;
+            T value;
+        };
+
+        static uint64_t mix(uint64_t h)
+        {
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 33;
+            return h;
+        }
+
+        // the high half of the hash picks a bucket, and the low half mixed
+        // with the bucket's seed picks the slot
+        size_t bucket(uint64_t h) const { return static_cast<size_t>(mix(h) >> 32) & (seeds_.size() - 1); }
+        size_t slot(uint64_t h, uint32_t seed) const
+        {
+            return static_cast<size_t>(mix(h ^ (seed * 0x9e3779b97f4a7c15ull))) & (slots_.size() - 1);
+        }
+
+        const entry *find(string_ref s) const
+        {
+            if (entries_.empty())
+                return nullptr;
+            uint64_t h = detail::hash_string(s);
+            uint32_t i = slots_[slot(h, seeds_[bucket(h)])];
+            return i && string_ref(entries_[i - 1].name) == s ? &entries_[i - 1] : nullptr;
+        }
+
+        // hash and displace: buckets of about four names are placed largest
+        // first, each trying seeds until all of its names land on free slots
+        void build()
+        {
+            size_t n = entries_.size();
+            if (n == 0)
+                return;
+
+            size_t buckets = 1;
+            while (buckets * 4 < n)
+                buckets *= 2;
+            size_t slots = 1;
+            while (slots < 2 * n)
+                slots *= 2;
+
+            std::vector<uint64_t> hashes(n);
+            for (size_t i = 0; i < n; i++)
+                hashes[i] = detail::hash_string(entries_[i].name);
+
+            for (;;)
+            {
+                seeds_.assign(buckets, 0);
+                slots_.assign(slots, 0);
+                if (place(hashes))
+                    return;
+                // only happens for duplicates or very unlucky hashes
+                slots *= 2;
+            }
+        }
+
+        bool place(const std::vector<uint64_t> &hashes)
+        {
+            std::vector<std::vector<uint32_t> > members(seeds_.size());
+            for (size_t i = 0; i < hashes.size(); i++)
+                members[bucket(hashes[i])].push_back(static_cast<uint32_t>(i));
+
+            std::vector<uint32_t> order(members.size());
+            for (size_t b = 0; b < order.size(); b++)
+                order[b] = static_cast<uint32_t>(b);
+            std::stable_sort(order.begin(), order.end(),
+                             [&](uint32_t a, uint32_t b) { return members[a].size() > members[b].size(); });
+
+            std::vector<size_t> taken;
+            for (uint32_t b : order)
+            {
+                const std::vector<uint32_t> &keys = members[b];
+                if (keys.empty())
+                    break;
+                for (uint32_t seed = 0;; seed++)
+                {
+                    if (seed == max_seed) {
+                        check_duplicates(keys);
+                        return false;
+                    }
+                    taken.clear();
+                    for (uint32_t k : keys)
+                    {
+                        size_t at = slot(hashes[k], seed);
+                        if (slots_[at] || std::find(taken.begin(), taken.end(), at) != taken.end())
+                            break;
+                        taken.push_back(at);
+                    }
+                    if (taken.size() == keys.size()) {
+                        for (size_t j = 0; j < keys.size(); j++)
+                            slots_[taken[j]] = keys[j] + 1;
+                        seeds_[b] = seed;
+                        break;
+                    }
+                }
+            }
+            return true;
+        }
+
+        void check_duplicates(const std::vector<uint32_t> &keys) const
+        {
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                for (size_t j = i + 1; j < keys.size(); j++)
+                {
+                    if (entries_[keys[i]].name == entries_[keys[j]].name)
+                        throw cmdline_error("multiple definition: " + entries_[keys[i]].name);
+                }
+            }
+        }
+
+        static const uint32_t max_seed = 1 << 16;
+
+        std::vector<entry> entries_;
+        std::vector<uint32_t> seeds_;
+        // index + 1 of the entry in each slot, 0 for none
+        std::vector<uint32_t> slots_;
+        // see complete()
+        mutable std::vector<std::string> sorted_;
     };
 }
+
+namespace cmdline { namespace detail {
+    // readers taking a string_ref get the raw view, other readers a std::string
+    template <class F>
+    struct accepts_string_ref
+    {
+        template <class G>
+        static auto test(int) -> decltype(std::declval<G&>()(std::declval<string_ref>()), std::true_type());
+        template <class G>
+        static std::false_type test(...);
+
+        static const bool value = decltype(test<F>(0))::value;
+    };
+
+    // readers that can name a value, like enum_reader, name the default
+    template <class F, class T>
+    struct names_values
+    {
+        template <class G>
+        static auto test(int) -> decltype(std::string(std::declval<const G&>().name(std::declval<const T&>())),
+                                          std::true_type());
+        template <class G>
+        static std::false_type test(...);
+
+        static const bool value = decltype(test<F>(0))::value;
+    };
+
+    template <class T, class F>
+    std::string default_text(const F &reader, const T &def, std::true_type) { return reader.name(def); }
+
+    template <class T, class F>
+    std::string default_text(const F &, const T &def, std::false_type) { return default_value(def); }
+
+    // def as usage() shows it
+    template <class T, class F>
+    std::string default_text(const F &reader, const T &def)
+    {
+        return default_text(reader, def, std::integral_constant<bool, names_values<F, T>::value>());
+    }
+
+    template <class T, class F>
+    T invoke_reader(F &reader, string_ref s, std::true_type) { return reader(s); }
+
+    template <class T, class F>
+    T invoke_reader(F &reader, string_ref s, std::false_type) { return reader(std::string(s)); }
+
+    template <class T, class F>
+    T invoke_reader(F &reader, string_ref s)
+    {
+        return invoke_reader<T>(reader, s, std::integral_constant<bool, accepts_string_ref<F>::value>());
+    }
+
+    // readers with a bool read(string_ref, T&) member
+    template <class F, class T>
+    struct reads_in_place
+    {
+        template <class G>
+        static auto test(int) -> decltype(bool(std::declval<G&>().read(std::declval<string_ref>(), std::declval<T&>())),
+                                          std::true_type());
+        template <class G>
+        static std::false_type test(...);
+
+        typedef decltype(test<F>(0)) type;
+        static const bool value = type::value;
+    };
+
+    // readers with a complete(string_ref, std::vector<std::string>&) member
+    template <class F>
+    struct completes
+    {
+        template <class G>
+        static auto test(int) -> decltype(std::declval<const G&>().complete(std::declval<string_ref>(),
+                                                                            std::declval<std::vector<std::string>&>()),
+                                          std::true_type());
+        template <class G>
+        static std::false_type test(...);
+
+        typedef decltype(test<F>(0)) type;
+    };
+
+    template <class F>
+    void complete_with(const F &reader, string_ref prefix, std::vector<std::string> &out, std::true_type)
+    {
+        reader.complete(prefix, out);
+    }
+
+    template <class F>
+    void complete_with(const F &, string_ref, std::vector<std::string> &, std::false_type) {}
+
+    // the values reader offers that start with prefix, if it has a set of them
+    template <class F>
+    void complete_with(const F &reader, string_ref prefix, std::vector<std::string> &out)
+    {
+        complete_with(reader, prefix, out, typename completes<F>::type());
+    }
+
+    template <class T, class F>
+    bool read_with(F &reader, string_ref s, T &out, std::true_type) { return reader.read(s, out); }
+
+    template <class T, class F>
+    bool read_with(F &reader, string_ref s, T &out, std::false_type)
+    {
+        try {
+            out = invoke_reader<T>(reader, s);
+        } catch (const std::exception &) {
+            return false;
+        }
+        return true;
+    }
+
+    // converts s into out with reader, without letting exceptions out
+    template <class T, class F>
+    bool read_with(F &reader, string_ref s, T &out)
+    {
+        return read_with(reader, s, out, typename reads_in_place<F, T>::type());
+    }
+} }
@@ -0,0 +1,1272 @@
+/*
+  Copyright (c) 2009-2019, Hideyuki Tanaka, Joel
+  All rights reserved.
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+  * Neither the name of the <organization> nor the
+  names of its contributors may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+  THIS SOFTWARE IS PROVIDED BY <copyright holder> ''AS IS'' AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "arena.hpp"
+#include "config.hpp"
+#include "environment.hpp"
+#include "error.hpp"
+#include "instrumentation.hpp"
+#include "mapped_file.hpp"
+#include "options.hpp"
+#include "reader.hpp"
+#include "string_ref.hpp"
+#include "suggest.hpp"
+#include "terminal.hpp"
+#include "tokenizer.hpp"
+
+namespace cmdline
+{
+    class parse_result;
+
+    // what schema::usage() renders
+    struct usage_format
+    {
+        usage_format() : width(0), filter(false), first(0), count(static_cast<size_t>(-1)) {}
+
+        // wrap descriptions to fit this many columns, 0 for the terminal's
+        size_t width;
+        // only list the options of this section
+        bool filter;
+        std::string section;
+        // only list count options, starting with the first-th
+        size_t first;
+        size_t count;
+    };
+
+    // the option definitions of a command line. parsing is const and keeps
+    // all of its state in a parse_result, so a schema that is no longer
+    // modified can be shared by any number of threads without locking.
+    // freeze() turns further add() calls into errors.
+    class schema
+    {
+    public:
+        schema() : pool_(arena_) {}
+        schema(const schema &) = delete;
+        schema &operator=(const schema &) = delete;
+        ~schema()
+        {
+            // the arena releases the memory
+            for (auto &o : ordered_)
+                o->~option_base();
+        }
+
+        // names and descriptions are copied into the schema; the text
+        // usage() shows is only built when usage() runs
+        flag_handle add(string_ref name, char short_name = 0, string_ref desc = "")
+        {
+            check_new(name, short_name);
+
+            auto opt = arena_.create<option::option_without_value>(pool_.intern(name), short_name, pool_.intern(desc));
+            insert(opt);
+            return flag_handle(opt);
+        }
+
+        template <class T>
+        option_handle<T> add(string_ref name, char short_name = 0,
+                          string_ref desc = "", bool need = true, const T def = T())
+        {
+            return add(name, short_name, desc, need, def, default_reader<T>());
+        }
+
+        template <class T, class F>
+        option_handle<T> add(string_ref name, char short_name=0,
+                          string_ref desc = "", bool need = true, const T def = T(), F reader = F())
+        {
+            check_new(name, short_name);
+
+            auto opt = arena_.create<option::option_with_value_with_reader<T, F> >(
+                    pool_.intern(name), short_name, need, def, pool_.intern(desc), reader);
+            insert(opt);
+            return option_handle<T>(opt);
+        }
+
+        // binds an option to a variable of the caller, e.g. a member of a
+        // config struct: parse() converts values straight into *target and
+        // nothing has to be copied out of the result. the value *target has
+        // now is the default. every parse writes to *target, so a schema
+        // with bound options must not parse on several threads at once.
+        template <class T>
+        option_handle<T> add(string_ref name, char short_name, string_ref desc, T *target, bool need = false)
+        {
+            return add(name, short_name, desc, target, need, default_reader<T>());
+        }
+
+        template <class T, class F>
+        option_handle<T> add(string_ref name, char short_name, string_ref desc, T *target, bool need, F reader)
+        {
+            check_new(name, short_name);
+
+            auto opt = arena_.create<option::option_with_target<T, F> >(
+                    pool_.intern(name), short_name, need, target, pool_.intern(desc), reader);
+            insert(opt);
+            bound_.push_back(opt);
+            return option_handle<T>(opt);
+        }
+
+        // a flag bound to a bool of the caller, which parse() sets to true
+        // when the flag is given. add<bool>() binds an option taking a value.
+        flag_handle add(string_ref name, char short_name, string_ref desc, bool *target)
+        {
+            check_new(name, short_name);
+
+            auto opt = arena_.create<option::flag_with_target>(pool_.intern(name), short_name, target, pool_.intern(desc));
+            insert(opt);
+            bound_.push_back(opt);
+            return flag_handle(opt);
+        }
+
+        // an option that can be given many times, collecting its values in
+        // a std::vector<T>. with a delimiter, "--ids=1,2,3" adds 3 values.
+        template <class T>
+        option_handle<std::vector<T> > add_list(string_ref name, char short_name = 0,
+                                             string_ref desc = "", bool need = false, char delimiter = 0)
+        {
+            return add_list<T>(name, short_name, desc, need, delimiter, default_reader<T>());
+        }
+
+        template <class T, class F>
+        option_handle<std::vector<T> > add_list(string_ref name, char short_name,
+                                             string_ref desc, bool need, char delimiter, F reader)
+        {
+            check_new(name, short_name);
+
+            auto opt = arena_.create<option::option_with_values<T, F> >(
+                    pool_.intern(name), short_name, need, delimiter, pool_.intern(desc), reader);
+            insert(opt);
+            return option_handle<std::vector<T> >(opt);
+        }
+
+        void footer(const std::string &f)
+        {
+            footer_ = f;
+            ++revision_;
+        }
+        const std::string &footer() const { return footer_; }
+
+        // in zero copy mode positional arguments are kept as views into argv
+        // (or into the tokens of parse(const std::string&)) and only copied
+        // to std::string if rest() is called. argv must outlive the results.
+        void set_zero_copy(bool zero_copy) { zero_copy_ = zero_copy; }
+
+        // expand @file arguments with the contents of file, split with the
+        // quoting rules of parse(const std::string&) plus newlines and tabs.
+        // the file is memory mapped and tokenized while it is parsed.
+        void set_response_files(bool response_files) { response_files_ = response_files; }
+
+        // adds a string option naming a config file. parse() reads the file
+        // after the command line and the environment, and sets the options
+        // still unset from its "key = value" lines; a key under "[section]"
+        // sets the option "section.key". unknown keys are ignored.
+        option_handle<std::string> add_config(const std::string &name, char short_name = 0,
+                                              const std::string &desc = "config file",
+                                              const std::string &path = "")
+        {
+            option_handle<std::string> ref = add<std::string>(name, short_name, desc, false, path);
+            config_ = static_cast<const option::option_with_value<std::string>*>(find(name));
+            return ref;
+        }
+
+        // the option added by add_config(), or nullptr
+        const option::option_with_value<std::string> *config_option() const { return config_; }
+
+        // fill option name from the environment variable var when it is
+        // not given on the command line
+        void bind_env(const std::string &name, const std::string &var)
+        {
+            const option::option_base *opt = find(name);
+            if (!opt)
+                throw cmdline_error("there is no flag: --" + name);
+            if (env_names_.size() <= opt->index())
+                env_names_.resize(ordered_.size());
+
+            // only the entry of opt changes: its earlier name, or the one
+            // derived from the prefix, stops answering for it
+            string_ref &bound = env_names_[opt->index()];
+            if (!bound.empty())
+                unindex_environment(bound, opt);
+            else if (env_prefix_set_)
+                unindex_environment(environment_name(opt), opt);
+            bound = pool_.intern(var);
+            env_index_.insert(bound, opt);
+        }
+
+        // fill every option without bind_env() from prefix followed by its
+        // name in upper case, with '-' and '.' turned into '_'
+        void set_env_prefix(const std::string &prefix)
+        {
+            if (env_prefix_set_ && env_prefix_ == prefix)
+                return;
+            env_prefix_ = prefix;
+            env_prefix_set_ = true;
+            index_environment();
+        }
+
+        // in lazy mode parse() only records where each value is, and
+        // converts it on its first get(). invalid values then make get()
+        // throw, unless parse_result::validate_all() reported them before.
+        // values are views into the arguments, so the argv given to
+        // parse(argc, argv) must outlive the result.
+        void set_lazy(bool lazy) { lazy_ = lazy; }
+        bool lazy() const { return lazy_; }
+
+        // accept unambiguous prefixes of long option names, like getopt_long
+        // does: --verb for --verbose, but not --ver if --version exists too
+        void set_abbreviations(bool abbreviations) { abbreviations_ = abbreviations; }
+        bool abbreviations() const { return abbreviations_; }
+
+        void freeze()
+        {
+            frozen_ = true;
+            sort_names();
+        }
+        bool frozen() const { return frozen_; }
+
+        // option called name, or nullptr
+        const option::option_base *find(string_ref name) const
+        {
+            auto found = names_.find(name);
+            return found ? *found : nullptr;
+        }
+
+        // options in the order they were added
+        const std::vector<option::option_base*> &options() const { return ordered_; }
+
+        bool parse(const std::string &arg, parse_result &r) const;
+        bool parse(const std::vector<std::string> &args, parse_result &r) const;
+        bool parse(int argc, const char * const argv[], parse_result &r) const;
+
+        // appends the completions of the last of words, the arguments after
+        // the program name up to the cursor: long option names from the
+        // sorted name index, short options for "-", and the values the
+        // reader of an option offers after "--name=", "--name" or "-n".
+        // bash splits "--name=value" into "--name", "=" and "value", which
+        // is understood too.
+        void complete(const std::vector<string_ref> &words, std::vector<std::string> &out) const;
+
+        std::string usage(const std::string &program_name, const usage_format &format = usage_format()) const
+        {
+            const size_t width = format.width ? format.width : detail::terminal_width();
+
+            // "  -x, --" name padding description
+            size_t max_width = 0;
+            for (auto &o : ordered_)
+                max_width = std::max(max_width, o->name().size());
+            const size_t column = 8 + max_width + 4;
+            const size_t text_width = width > column + min_text_width ? width - column : 0;
+
+            const size_t last = format.count > ordered_.size() - std::min(format.first, ordered_.size())
+                                ? ordered_.size() : format.first + format.count;
+
+            std::string head = "usage: " + program_name + " ";
+            for (auto &o : ordered_)
+            {
+                if (o->must())
+                    head += o->short_description() + " ";
+            }
+            head += "[options] ... \n";
+
+            // room for every line, assuming wrapped lines come out half full
+            // and types and defaults take about 16 characters
+            size_t bytes = head.size() + footer_.size() + 16;
+            for (size_t i = format.first; i < last; i++)
+            {
+                size_t desc = ordered_[i]->description().size() + 16;
+                bytes += column + desc + 1;
+                if (text_width)
+                    bytes += desc * 2 / text_width * (column + 1);
+            }
+            for (auto &sec : sections_)
+                bytes += sec.second.size() + 3;
+
+            std::string out;
+            out.reserve(bytes);
+            out += head;
+
+            std::string desc;
+            const string_ref *current = nullptr;
+            size_t next_section = 0;
+            string_ref untitled("options");
+            // the header is there even without options, as it always was
+            if (ordered_.empty() && !format.filter) {
+                out.append(untitled.data(), untitled.size());
+                out += ":\n";
+            }
+            for (size_t i = 0; i < last; i++)
+            {
+                const string_ref *title = &untitled;
+                while (next_section < sections_.size() && sections_[next_section].first <= i)
+                    ++next_section;
+                if (next_section > 0)
+                    title = &sections_[next_section - 1].second;
+
+                if (i < format.first || (format.filter && *title != string_ref(format.section)))
+                    continue;
+
+                if (title != current) {
+                    if (current)
+                        out += '\n';
+                    out.append(title->data(), title->size());
+                    out += ":\n";
+                    current = title;
+                }
+
+                const option::option_base *o = ordered_[i];
+                if (o->short_name()) {
+                    out += "  -";
+                    out += o->short_name();
+                    out += ", ";
+                } else {
+                    out.append(6, ' ');
+                }
+                out += "--";
+                out.append(o->name().data(), o->name().size());
+                out.append(max_width + 4 - o->name().size(), ' ');
+                desc.clear();
+                o->describe(desc);
+                append_wrapped(out, desc, column, text_width);
+            }
+
+            if (last == ordered_.size()) {
+                out += '\n';
+                out += footer_;
+                out += '\n';
+            }
+            return out;
+        }
+
+        // options added after this call are listed under title in usage()
+        void section(const std::string &title)
+        {
+            sections_.emplace_back(ordered_.size(), pool_.intern(title));
+            ++revision_;
+        }
+
+        // changes whenever add(), footer() or section() change the usage
+        unsigned long revision() const { return revision_; }
+
+    private:
+        friend class parse_result;
+        class arg_source;
+
+        // descriptions are not wrapped into a narrower column than this
+        static const size_t min_text_width = 20;
+        // ambiguous abbreviations list this many of the options they match
+        static const long max_candidates = 8;
+
+        static void append_wrapped(std::string &out, string_ref text, size_t column, size_t text_width)
+        {
+            while (text_width && text.size() > text_width)
+            {
+                size_t cut = text_width;
+                while (cut > 0 && text[cut] != ' ')
+                    --cut;
+                if (cut == 0) {
+                    // a word longer than the column goes on a line of its own
+                    cut = text.find(' ', text_width);
+                    if (cut == string_ref::npos)
+                        break;
+                }
+                out.append(text.data(), cut);
+                out += '\n';
+                out.append(column, ' ');
+
+                while (cut < text.size() && text[cut] == ' ')
+                    ++cut;
+                text = text.substr(cut);
+            }
+            out.append(text.data(), text.size());
+            out += '\n';
+        }
+
+        void check_new(string_ref name, char short_name) const
+        {
+            if (frozen_)
+                throw cmdline_error(std::string("schema is frozen: cannot add --") + name);
+            if (find(name))
+                throw cmdline_error(std::string("multiple definition: ") + name);
+            if (short_name && short_options_[static_cast<unsigned char>(short_name)])
+                throw cmdline_error(std::string("short option '") + short_name + "' is ambiguous");
+        }
+
+        void insert(option::option_base *opt)
+        {
+            size_t align = opt->value_align();
+            storage_size_ = (storage_size_ + align - 1) / align * align;
+            opt->place(ordered_.size(), storage_size_);
+            storage_size_ += opt->value_size();
+
+            ordered_.push_back(opt);
+            ++revision_;
+
+            names_.insert(opt->name(), opt);
+            sorted_ready_.store(false, std::memory_order_relaxed);
+
+            if (opt->short_name())
+                short_options_[static_cast<unsigned char>(opt->short_name())] = opt;
+
+            if (env_prefix_set_) {
+                string_ref var = environment_name(opt);
+                if (!env_index_.find(var))
+                    env_index_.insert(var, opt);
+            }
+        }
+
+        static bool name_less(const option::option_base *a, const option::option_base *b)
+        {
+            return a->name() < b->name();
+        }
+        static bool size_less(const option::option_base *a, const option::option_base *b)
+        {
+            return a->name().size() < b->name().size();
+        }
+
+        // builds sorted_ and by_size_ once after the last add(). parsing is
+        // const and may run on many threads, hence the lock.
+        void sort_names() const
+        {
+            if (sorted_ready_.load(std::memory_order_acquire))
+                return;
+            std::lock_guard<std::mutex> lock(sorted_mutex_);
+            if (sorted_ready_.load(std::memory_order_relaxed))
+                return;
+            sorted_ = ordered_;
+            std::sort(sorted_.begin(), sorted_.end(), name_less);
+            by_size_ = ordered_;
+            std::stable_sort(by_size_.begin(), by_size_.end(), size_less);
+            sorted_ready_.store(true, std::memory_order_release);
+        }
+
+        bool parse(arg_source &args, parse_result &r) const;
+        const option::option_base *resolve(parse_result &r, string_ref name) const;
+        typedef std::vector<option::option_base*>::const_iterator name_iterator;
+        std::pair<name_iterator, name_iterator> prefixed(string_ref prefix) const;
+        // parts of the messages of parse_result::error()
+        std::string candidates(string_ref prefix) const;
+        std::string suggest(string_ref name) const;
+        string_ref environment_name(const option::option_base *opt)
+        {
+            return pool_.intern(detail::environment_name(env_prefix_, opt->name()));
+        }
+
+        void unindex_environment(string_ref var, const option::option_base *opt)
+        {
+            auto found = env_index_.find(var);
+            if (found && *found == opt)
+                env_index_.erase(var);
+        }
+
+        // names from the prefix first, so that bind_env() wins on a clash.
+        // options with bind_env() only answer to their bound name.
+        void index_environment()
+        {
+            env_index_.clear();
+            if (env_prefix_set_) {
+                for (auto &o : ordered_)
+                {
+                    if (o->index() < env_names_.size() && !env_names_[o->index()].empty())
+                        continue;
+                    env_index_.insert(environment_name(o), o);
+                }
+            }
+            for (size_t i = 0; i < env_names_.size(); i++)
+            {
+                if (!env_names_[i].empty())
+                    env_index_.insert(env_names_[i], ordered_[i]);
+            }
+        }
+
+        void fill_from_environment(parse_result &r) const;
+        void restore_bound(const parse_result &r) const;
+        void load_config(const std::string &path, parse_result &r) const;
+        // the option argument arg gives a value to when that value is the
+        // next argument, or nullptr
+        const option::option_base *takes_next(string_ref arg) const;
+
+        void set_option(parse_result &r, const option::option_base *opt) const;
+        void set_option(parse_result &r, const option::option_base *opt, string_ref value) const;
+
+        std::string footer_;
+        // options and their names and descriptions, laid out one after
+        // another and released at once
+        detail::arena arena_;
+        detail::string_pool pool_;
+        std::vector<option::option_base*> ordered_;
+        // options bound to variables of the caller
+        std::vector<const option::option_base*> bound_;
+        // titles of sections and the index of their first option
+        std::vector<std::pair<size_t, string_ref> > sections_;
+        // options by name, so that parse() and config files can look names
+        // up without building a std::string
+        detail::string_map<option::option_base*> names_;
+        // options sorted by name for abbreviations, and by the length of
+        // their name for suggestions; see sort_names()
+        mutable std::vector<option::option_base*> sorted_;
+        mutable std::vector<option::option_base*> by_size_;
+        mutable std::atomic<bool> sorted_ready_{false};
+        mutable std::mutex sorted_mutex_;
+        // environment variables: bound with bind_env() by option index (only as
+        // far as the last bound option), and all of them by name
+        std::vector<string_ref> env_names_;
+        detail::string_map<const option::option_base*> env_index_;
+        std::string env_prefix_;
+        bool env_prefix_set_ = false;
+        const option::option_with_value<std::string> *config_ = nullptr;
+        // direct index of options by short name, filled by add()
+        option::option_base *short_options_[256] = {};
+        size_t storage_size_ = 0;
+        unsigned long revision_ = 0;
+        bool zero_copy_ = false;
+        bool response_files_ = false;
+        bool lazy_ = false;
+        bool abbreviations_ = false;
+        bool frozen_ = false;
+    };
+
+    // the outcome of one schema::parse(). a result can be reused for any
+    // number of parses; each parse starts by resetting it, which keeps the
+    // memory of the previous one.
+    class parse_result
+    {
+    public:
+        parse_result() = default;
+        // a result of s that reads as empty until s parses into it
+        explicit parse_result(const schema &s) : schema_(&s) {}
+        parse_result(const parse_result &) = delete;
+        parse_result &operator=(const parse_result &) = delete;
+
+        bool ok() const { return errors_.empty(); }
+        parse_error error_code() const { return errors_.empty() ? parse_error::none : errors_[0].code; }
+        size_t error_count() const { return errors_.size(); }
+
+        bool exist(const std::string &name) const
+        {
+            return lookup(name)->has_set(values_);
+        }
+
+        template <class T>
+        const T &get(const std::string &name) const
+        {
+            auto p = dynamic_cast<const option::option_with_value<T>*>(lookup(name));
+            if (!p)
+                throw cmdline_error("type mismatch flag '" + name + "'");
+            return p->get(values_);
+        }
+
+        template <class T>
+        const T &get(const option_handle<T> &ref) const { return ref.get(values_); }
+
+        // raw text of the last value given to an option. it is a view into
+        // the parsed arguments and is valid as long as they are.
+        string_ref raw(const std::string &name) const
+        {
+            return lookup(name)->raw(values_);
+        }
+
+        const std::vector<std::string> &rest() const
+        {
+            if (zero_copy_ && rest_stale_) {
+                others_.clear();
+                others_.reserve(rest_refs_.size());
+                for (auto &r : rest_refs_)
+                    others_.emplace_back(r.data(), r.size());
+                rest_stale_ = false;
+            }
+            return others_;
+        }
+
+        const std::vector<string_ref> &rest_view() const
+        {
+            if (!zero_copy_ && rest_stale_) {
+                rest_refs_.assign(others_.begin(), others_.end());
+                rest_stale_ = false;
+            }
+            return rest_refs_;
+        }
+
+        const std::string &program_name() const { return program_name_; }
+
+        // converts the values a lazy parse left raw and reports the invalid
+        // ones like an eager parse would
+        bool validate_all()
+        {
+            if (schema_ && !validated_) {
+                for (auto &o : schema_->options())
+                {
+                    if (!o->validate(values_))
+                        fail(parse_error::invalid_value, o, o->raw(values_));
+                }
+                validated_ = true;
+            }
+            return ok();
+        }
+
+        std::string error() const {
+            return errors_.empty() ? "" : format(errors_[0]);
+        }
+
+        std::string error_full() const
+        {
+            std::string ret;
+            for (auto &err : errors_)
+                ret += format(err) + "\n";
+            return ret;
+        }
+
+        const option::value_store &values() const { return values_; }
+
+        // counts and times the following parses into inst, until it is
+        // set to nullptr. it does nothing unless instrumentation::enabled.
+        void set_instrumentation(instrumentation *inst)
+        {
+#if defined(CMDLINE_ENABLE_INSTRUMENTATION)
+            probe_.attach(inst);
+#else
+            (void)inst;
+#endif
+        }
+
+    private:
+        friend class schema;
+
+        // a range of error_text_
+        struct text_span
+        {
+            size_t offset;
+            size_t size;
+        };
+
+        struct error_record
+        {
+            parse_error code;
+            const option::option_base *opt;
+            // the argument or value, and the file or variable it came from
+            text_span arg;
+            text_span where;
+            size_t line;
+        };
+
+        // arg and where are copied, so errors do not depend on argv or the
+        // environment outliving the result
+        void fail(parse_error code, const option::option_base *opt = nullptr,
+                  string_ref arg = string_ref(), string_ref where = string_ref(), size_t line = 0)
+        {
+            CMDLINE_PROBE(*this, error(code, opt));
+            error_record e;
+            e.code = code;
+            e.opt = opt;
+            e.arg = keep(arg);
+            e.where = keep(where);
+            e.line = line;
+            errors_.push_back(e);
+        }
+
+        text_span keep(string_ref s)
+        {
+            text_span span = { error_text_.size(), s.size() };
+            error_text_.append(s.data(), s.size());
+            return span;
+        }
+
+        string_ref text(text_span span) const { return string_ref(error_text_.data() + span.offset, span.size); }
+
+        std::string format(const error_record &e) const;
+
+        const option::option_base *lookup(const std::string &name) const
+        {
+            auto opt = schema_ ? schema_->find(name) : nullptr;
+            if (!opt)
+                throw cmdline_error("there is no flag: --" + name);
+            return opt;
+        }
+
+        void reset(const schema &s, size_t slots, size_t bytes)
+        {
+            // the slots of another schema hold other types
+            values_.bind(slots, bytes, schema_ == &s);
+            schema_ = &s;
+            values_.set_lazy(s.lazy());
+            validated_ = false;
+            errors_.clear();
+            error_text_.clear();
+            others_.clear();
+            rest_refs_.clear();
+            rest_stale_ = true;
+            mapped_.clear();
+            escaped_.clear();
+            program_name_.clear();
+            CMDLINE_PROBE(*this, begin(s.options()));
+        }
+
+        const schema *schema_ = nullptr;
+        option::value_store values_;
+        std::string program_name_;
+        std::vector<error_record> errors_;
+        std::string error_text_;
+        mutable std::vector<std::string> others_;
+        mutable std::vector<string_ref> rest_refs_;
+        mutable bool rest_stale_ = false;
+        bool zero_copy_ = false;
+        bool validated_ = false;
+        // storage the views of the last parse point into
+        std::string line_;
+        // scratch space of config file loading
+        std::vector<char> given_;
+        std::string config_key_;
+        std::vector<const char*> argv_;
+        std::vector<std::unique_ptr<detail::mapped_file> > mapped_;
+        std::deque<std::string> escaped_;
+#if defined(CMDLINE_ENABLE_INSTRUMENTATION)
+        detail::probe probe_;
+#endif
+    };
+
+    // arguments of one parse() call: argv, or the arguments split from a
+    // string, with @file arguments replaced by the arguments read from file
+    class schema::arg_source
+    {
+    public:
+        arg_source(const schema &s, parse_result &r, int argc, const char * const argv[])
+                : schema_(s), result_(r), argc_(argc), argv_(argv) {}
+
+        arg_source(const schema &s, parse_result &r, detail::tokenizer &line)
+                : schema_(s), result_(r), argc_(0), argv_(nullptr), line_(&line) {}
+
+        bool next(string_ref &arg)
+        {
+            for (;;)
+            {
+                if (!files_.empty()) {
+                    file_frame &f = files_.back();
+                    if (!f.tok.next(arg)) {
+                        if (f.tok.error())
+                            result_.fail(parse_error::syntax_error, nullptr, f.tok.error(), f.path);
+                        files_.pop_back();
+                        continue;
+                    }
+                    // unescaped arguments live in the tokenizer, keep a copy
+                    if (f.tok.escaped()) {
+                        result_.escaped_.emplace_back(arg.data(), arg.size());
+                        arg = string_ref(result_.escaped_.back());
+                    }
+                } else if (line_) {
+                    if (!line_->next(arg)) {
+                        if (line_->error())
+                            result_.fail(parse_error::syntax_error, nullptr, line_->error());
+                        return false;
+                    }
+                } else {
+                    if (i_ >= argc_)
+                        return false;
+                    arg = string_ref(argv_[i_++]);
+                }
+
+                if (schema_.response_files_ && arg.size() > 1 && arg[0] == '@') {
+                    open(std::string(arg.substr(1)));
+                    continue;
+                }
+                return true;
+            }
+        }
+
+        // the string could not be split to the end
+        bool truncated() const { return line_ && line_->error(); }
+
+    private:
+        struct file_frame
+        {
+            file_frame(const std::string &path, string_ref buf) : path(path), tok(buf, true) {}
+            std::string path;
+            detail::tokenizer tok;
+        };
+
+        void open(const std::string &path)
+        {
+            if (files_.size() >= max_depth) {
+                result_.fail(parse_error::response_file_too_deep, nullptr, string_ref(), path);
+                return;
+            }
+            std::unique_ptr<detail::mapped_file> file(new detail::mapped_file);
+            if (!file->open(path)) {
+                result_.fail(parse_error::cannot_open_response_file, nullptr, string_ref(), path);
+                return;
+            }
+            files_.emplace_back(path, file->view());
+            result_.mapped_.push_back(std::move(file));
+        }
+
+        static const size_t max_depth = 16;
+
+        const schema &schema_;
+        parse_result &result_;
+        int argc_;
+        const char * const *argv_;
+        int i_ = 1;
+        detail::tokenizer *line_ = nullptr;
+        std::vector<file_frame> files_;
+    };
+
+    inline bool schema::parse(const std::string &arg, parse_result &r) const
+    {
+        r.reset(*this, ordered_.size(), storage_size_);
+        r.zero_copy_ = zero_copy_;
+
+        // arguments are views into a copy kept in the result, unescaped in
+        // place, so they outlive arg
+        std::string &line = r.line_;
+        line.assign(arg);
+        detail::tokenizer tok(&line[0], &line[0] + line.size(), false);
+
+        string_ref program_name;
+        if (!tok.next(program_name)) {
+            if (tok.error())
+                r.fail(parse_error::syntax_error, nullptr, tok.error());
+            else
+                r.fail(parse_error::no_arguments);
+            restore_bound(r);
+            CMDLINE_PROBE(r, finish(false));
+            return false;
+        }
+        r.program_name_.assign(program_name.data(), program_name.size());
+
+        arg_source args(*this, r, tok);
+        return parse(args, r);
+    }
+
+    inline bool schema::parse(const std::vector<std::string> &args, parse_result &r) const
+    {
+        // the arguments are copied into the result, one after another with
+        // their terminating '\0', so lazy values and views outlive args
+        std::string &line = r.line_;
+        line.clear();
+        for (auto &a : args)
+            line.append(a.c_str(), a.size() + 1);
+
+        int argc = static_cast<int>(args.size());
+        std::vector<const char*> &argv = r.argv_;
+        argv.resize(argc);
+
+        size_t pos = 0;
+        for (int i=0; i<argc; i++) {
+            argv[i] = line.data() + pos;
+            pos += args[i].size() + 1;
+        }
+
+        return parse(argc, argv.data(), r);
+    }
+
+    inline bool schema::parse(int argc, const char * const argv[], parse_result &r) const
+    {
+        r.reset(*this, ordered_.size(), storage_size_);
+        r.zero_copy_ = zero_copy_;
+
+        if (argc<1){
+            r.fail(parse_error::no_arguments);
+            restore_bound(r);
+            CMDLINE_PROBE(r, finish(false));
+            return false;
+        }
+
+        r.program_name_ = argv[0];
+
+        arg_source args(*this, r, argc, argv);
+        return parse(args, r);
+    }
+
+    inline bool schema::parse(arg_source &args, parse_result &r) const
+    {
+        string_ref arg;
+        while ((CMDLINE_PROBE(r, enter(parse_phase::tokenize)), args.next(arg)))
+        {
+            CMDLINE_PROBE(r, enter(parse_phase::resolve));
+            if (arg.starts_with("--"))
+            {
+                string_ref body = arg.substr(2);
+                size_t eq = body.find('=');
+                if (eq != string_ref::npos){
+                    const option::option_base *opt = resolve(r, body.substr(0, eq));
+                    if (opt)
+                        set_option(r, opt, body.substr(eq + 1));
+                } else {
+                    const option::option_base *opt = resolve(r, body);
+                    if (!opt)
+                        continue;
+                    if (opt->has_value())
+                    {
+                        string_ref value;
+                        CMDLINE_PROBE(r, enter(parse_phase::tokenize));
+                        if (!args.next(value)) {
+                            r.fail(parse_error::option_needs_value, opt);
+                            continue;
+                        }
+                        set_option(r, opt, value);
+                    } else{
+                        set_option(r, opt);
+                    }
+                }
+            }
+            else if (arg.starts_with("-"))
+            {
+                for (size_t j = 1; j < arg.size(); j++)
+                {
+                    char c = arg[j];
+                    const option::option_base *opt = short_options_[static_cast<unsigned char>(c)];
+                    if (!opt) {
+                        r.fail(parse_error::undefined_short_option, nullptr, arg.substr(j, 1));
+                        continue;
+                    }
+
+                    // only the last option of a group can take the next argument
+                    string_ref value;
+                    bool last = j + 1 == arg.size() && opt->has_value();
+                    if (last)
+                        CMDLINE_PROBE(r, enter(parse_phase::tokenize));
+                    if (last && args.next(value))
+                        set_option(r, opt, value);
+                    else
+                        set_option(r, opt);
+                    CMDLINE_PROBE(r, enter(parse_phase::resolve));
+                }
+            }
+            else if (zero_copy_){
+                r.rest_refs_.push_back(arg);
+            }
+            else{
+                r.others_.emplace_back(arg.data(), arg.size());
+            }
+        }
+
+        if (args.truncated()) {
+            restore_bound(r);
+            CMDLINE_PROBE(r, finish(false));
+            return false;
+        }
+
+        CMDLINE_PROBE(r, enter(parse_phase::sources));
+        if (!env_index_.empty())
+            fill_from_environment(r);
+
+        if (config_) {
+            const std::string &path = config_->get(r.values_);
+            if (!path.empty())
+                load_config(path, r);
+        }
+
+        restore_bound(r);
+
+        CMDLINE_PROBE(r, enter(parse_phase::check));
+        for (auto &o : ordered_) {
+            if (!o->valid(r.values_))
+                r.fail(parse_error::need_option, o);
+        }
+
+        CMDLINE_PROBE(r, finish(r.ok()));
+        return r.ok();
+    }
+
+    // bound variables must not keep a value from an earlier parse
+    inline void schema::restore_bound(const parse_result &r) const
+    {
+        for (auto &o : bound_) {
+            if (!o->has_set(r.values_))
+                o->restore_default();
+        }
+    }
+
+    // one pass over the environment, looking each name up in the index of
+    // bound variables
+    inline void schema::fill_from_environment(parse_result &r) const
+    {
+        for (char **e = detail::environment(); e && *e; ++e)
+        {
+            string_ref entry(*e);
+            size_t eq = entry.find('=');
+            if (eq == string_ref::npos)
+                continue;
+            string_ref var = entry.substr(0, eq);
+            auto found = env_index_.find(var);
+            if (!found || (*found)->has_set(r.values_))
+                continue;
+
+            const option::option_base *opt = *found;
+            string_ref value = entry.substr(eq + 1);
+            if (!opt->has_value()) {
+                if (detail::flag_enabled(value)) {
+                    opt->set(r.values_);
+                    CMDLINE_PROBE(r, set(opt, value, value_source::environment, true));
+                }
+            } else {
+                bool ok = opt->set(r.values_, value);
+                CMDLINE_PROBE(r, set(opt, value, value_source::environment, ok));
+                if (!ok)
+                    r.fail(parse_error::invalid_environment_value, opt, value, var);
+            }
+        }
+    }
+
+    // the file stays mapped in the result, values are views into it
+    inline void schema::load_config(const std::string &path, parse_result &r) const
+    {
+        std::unique_ptr<detail::mapped_file> file(new detail::mapped_file);
+        if (!file->open(path)) {
+            r.fail(parse_error::cannot_open_config_file, nullptr, string_ref(), path);
+            return;
+        }
+
+        // options given on the command line or in the environment win
+        std::vector<char> &given = r.given_;
+        given.assign(ordered_.size(), 0);
+        for (auto &o : ordered_)
+            given[o->index()] = o->has_set(r.values_);
+
+        std::string &name = r.config_key_;
+        detail::config_reader reader(file->view());
+        string_ref section, key, value;
+        for (;;)
+        {
+            detail::config_reader::status status = reader.next(section, key, value);
+            if (status == detail::config_reader::end)
+                break;
+            if (status == detail::config_reader::malformed) {
+                r.fail(parse_error::config_syntax_error, nullptr, string_ref(), path, reader.line());
+                continue;
+            }
+
+            name.assign(section.data(), section.size());
+            if (!section.empty())
+                name += '.';
+            name.append(key.data(), key.size());
+
+            const option::option_base *opt = find(name);
+            if (!opt || given[opt->index()] || opt == config_)
+                continue;
+
+            if (!opt->has_value()) {
+                if (detail::flag_enabled(value)) {
+                    opt->set(r.values_);
+                    CMDLINE_PROBE(r, set(opt, value, value_source::config_file, true));
+                }
+            } else {
+                bool ok = opt->set(r.values_, value);
+                CMDLINE_PROBE(r, set(opt, value, value_source::config_file, ok));
+                if (!ok)
+                    r.fail(parse_error::invalid_config_value, opt, value, path, reader.line());
+            }
+        }
+        r.mapped_.push_back(std::move(file));
+    }
+
+    // the option a long name given on the command line stands for. names
+    // that are not one are only recorded, error() explains them.
+    inline const option::option_base *schema::resolve(parse_result &r, string_ref name) const
+    {
+        if (const option::option_base *opt = find(name))
+            return opt;
+
+        // "--" and "--=v" have no name, which every name starts with
+        if (abbreviations_ && !name.empty()) {
+            auto range = prefixed(name);
+            if (range.second - range.first == 1)
+                return *range.first;
+            if (range.first != range.second) {
+                r.fail(parse_error::ambiguous_option, nullptr, name);
+                return nullptr;
+            }
+        }
+        r.fail(parse_error::undefined_option, nullptr, name);
+        return nullptr;
+    }
+
+    // the options starting with prefix, a range of sorted_
+    inline std::pair<schema::name_iterator, schema::name_iterator> schema::prefixed(string_ref prefix) const
+    {
+        sort_names();
+        auto first = std::lower_bound(sorted_.begin(), sorted_.end(), prefix,
+                                      [](const option::option_base *o, string_ref n) { return o->name() < n; });
+        auto last = first;
+        while (last != sorted_.end() && (*last)->name().starts_with(prefix))
+            ++last;
+        return std::make_pair(first, last);
+    }
+
+    // " (--verbose, --version)" for the options an ambiguous prefix matches
+    inline std::string schema::candidates(string_ref prefix) const
+    {
+        auto range = prefixed(prefix);
+        std::string ret = " (";
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it - range.first == max_candidates) {
+                ret += ", ...";
+                break;
+            }
+            ret += it == range.first ? "--" : ", --";
+            ret.append((*it)->name().data(), (*it)->name().size());
+        }
+        return ret + ")";
+    }
+
+    // " (did you mean --name?)" for an unknown name, or "". only names no
+    // longer or shorter than the bound of the suggestions are compared.
+    inline std::string schema::suggest(string_ref name) const
+    {
+        if (name.empty())
+            return std::string();
+        sort_names();
+        detail::suggestions close(name);
+        const size_t shortest = name.size() - std::min(name.size(), close.bound());
+        auto it = std::lower_bound(by_size_.begin(), by_size_.end(), shortest,
+                                   [](const option::option_base *o, size_t n) { return o->name().size() < n; });
+        for (; it != by_size_.end() && (*it)->name().size() <= name.size() + close.bound(); ++it)
+            close.offer((*it)->name());
+        return close.text("--");
+    }
+
+    inline void schema::complete(const std::vector<string_ref> &words, std::vector<std::string> &out) const
+    {
+        size_t n = words.size();
+        string_ref word = n > 0 ? words[n - 1] : string_ref();
+        string_ref prev = n > 1 ? words[n - 2] : string_ref();
+
+        if (word == "=" && prev.starts_with("--")) {
+            if (const option::option_base *opt = takes_next(prev))
+                opt->complete(string_ref(), out);
+            return;
+        }
+        if (prev == "=" && n > 2 && words[n - 3].starts_with("--")) {
+            if (const option::option_base *opt = takes_next(words[n - 3]))
+                opt->complete(word, out);
+            return;
+        }
+        if (const option::option_base *opt = takes_next(prev)) {
+            opt->complete(word, out);
+            return;
+        }
+
+        if (word.starts_with("--")) {
+            string_ref body = word.substr(2);
+            size_t eq = body.find('=');
+            if (eq != string_ref::npos) {
+                const option::option_base *opt = takes_next(word.substr(0, eq + 2));
+                if (!opt)
+                    return;
+                size_t first = out.size();
+                opt->complete(body.substr(eq + 1), out);
+                for (size_t i = first; i < out.size(); i++)
+                    out[i].insert(0, word.data(), eq + 3);
+                return;
+            }
+            auto range = prefixed(body);
+            for (auto it = range.first; it != range.second; ++it)
+                out.push_back("--" + std::string((*it)->name()));
+        } else if (word == "-") {
+            for (auto &o : ordered_)
+            {
+                if (o->short_name())
+                    out.push_back(std::string("-") + o->short_name());
+            }
+            auto range = prefixed(string_ref());
+            for (auto it = range.first; it != range.second; ++it)
+                out.push_back("--" + std::string((*it)->name()));
+        }
+    }
+
+    inline const option::option_base *schema::takes_next(string_ref arg) const
+    {
+        const option::option_base *opt = nullptr;
+        if (arg.starts_with("--")) {
+            string_ref name = arg.substr(2);
+            if (name.empty() || name.find('=') != string_ref::npos)
+                return nullptr;
+            opt = find(name);
+            if (!opt && abbreviations_) {
+                auto range = prefixed(name);
+                if (range.second - range.first == 1)
+                    opt = *range.first;
+            }
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            opt = short_options_[static_cast<unsigned char>(arg[arg.size() - 1])];
+        }
+        return opt && opt->has_value() ? opt : nullptr;
+    }
+
+    inline void schema::set_option(parse_result &r, const option::option_base *opt) const
+    {
+        CMDLINE_PROBE(r, enter(parse_phase::convert));
+        bool ok = opt->set(r.values_);
+        CMDLINE_PROBE(r, set(opt, string_ref(), value_source::command_line, ok));
+        if (!ok)
+            r.fail(parse_error::option_needs_value, opt);
+    }
+
+    inline void schema::set_option(parse_result &r, const option::option_base *opt, string_ref value) const
+    {
+        CMDLINE_PROBE(r, enter(parse_phase::convert));
+        bool ok = opt->set(r.values_, value);
+        CMDLINE_PROBE(r, set(opt, value, value_source::command_line, ok));
+        if (!ok)
+            r.fail(parse_error::invalid_value, opt, value);
+    }
+
+    inline std::string parse_result::format(const error_record &e) const
+    {
+        const std::string name = e.opt ? "--" + std::string(e.opt->name()) : std::string();
+        const std::string arg(text(e.arg));
+        const std::string where(text(e.where));
+        switch (e.code)
+        {
+            case parse_error::none: return "";
+            case parse_error::no_arguments: return "argument number must be longer than 0";
+            case parse_error::syntax_error: return where.empty() ? arg : where + ": " + arg;
+            case parse_error::response_file_too_deep: return "response file nesting is too deep: @" + where;
+            case parse_error::cannot_open_response_file: return "cannot open response file: @" + where;
+            case parse_error::undefined_option:
+                return "undefined option: --" + arg + (schema_ ? schema_->suggest(text(e.arg)) : "");
+            case parse_error::ambiguous_option:
+                return "ambiguous option: --" + arg + (schema_ ? schema_->candidates(text(e.arg)) : "");
+            case parse_error::undefined_short_option: return "undefined short option: -" + arg;
+            case parse_error::option_needs_value: return "option needs value: " + name;
+            case parse_error::invalid_value: return "option value is invalid: " + name + "=" + arg;
+            case parse_error::invalid_environment_value:
+                return "option value is invalid: " + name + "=" + arg + " (from " + where + ")";
+            case parse_error::need_option: return "need option: " + name;
+            case parse_error::cannot_open_config_file: return "cannot open config file: " + where;
+            case parse_error::config_syntax_error: return where + ":" + std::to_string(e.line) + ": syntax error";
+            case parse_error::invalid_config_value:
+                return where + ":" + std::to_string(e.line) + ": option value is invalid: " + name + "=" + arg;
+        }
+        return "";
+    }
+}
@@ -0,0 +1,487 @@
+/*
+  Copyright (c) 2009-2019, Hideyuki Tanaka, Joel
+  All rights reserved.
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+  * Neither the name of the <organization> nor the
+  names of its contributors may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+  THIS SOFTWARE IS PROVIDED BY <copyright holder> ''AS IS'' AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <sstream>
+#include <string>
+#include <tuple>
+
+#include <cstring>
+
+#include "detail.hpp"
+#include "error.hpp"
+#include "reader.hpp"
+
+// A second front end for option sets that are known at compile time.
+//
+//   static const auto schema = cmdline::make_schema(
+//       cmdline::opt<std::string>("host", 'h', "host name"),
+//       cmdline::opt<int>("port", 'p', "port number", false, 80, cmdline::range(1, 65535)),
+//       cmdline::flag("gzip", '\0', "gzip when transfer"));
+//
+//   auto r = schema.parse(argc, argv);
+//   if (!r.ok()) ...
+//   int port = r.get<1>();
+//
+// Options are typed descriptors held in a std::tuple, the lookup tables are
+// fixed size arrays and values are dispatched through a table of function
+// pointers, so parsing uses no heap, no RTTI and no virtual calls. Readers
+// are invoked through a const reference and must be const callable; readers
+// taking a string_ref convert straight from argv.
+
+namespace cmdline
+{
+    namespace detail
+    {
+        template <size_t... I>
+        struct index_sequence {};
+
+        template <size_t N, size_t... I>
+        struct make_index_sequence : make_index_sequence<N - 1, N - 1, I...> {};
+
+        template <size_t... I>
+        struct make_index_sequence<0, I...> : index_sequence<I...> {};
+    }
+
+    struct flag_option
+    {
+        typedef bool value_type;
+        static constexpr bool has_value = false;
+
+        constexpr flag_option(const char *name, char short_name, const char *desc)
+                : name(name), short_name(short_name), desc(desc) {}
+
+        const char *name;
+        char short_name;
+        const char *desc;
+    };
+
+    template <class T, class F = default_reader<T> >
+    struct value_option
+    {
+        typedef T value_type;
+        typedef F reader_type;
+        static constexpr bool has_value = true;
+
+        constexpr value_option(const char *name, char short_name, const char *desc,
+                               bool need, const T &def, const F &reader)
+                : name(name), short_name(short_name), desc(desc), need(need), def(def), reader(reader) {}
+
+        const char *name;
+        char short_name;
+        const char *desc;
+        bool need;
+        T def;
+        F reader;
+    };
+
+    constexpr flag_option flag(const char *name, char short_name = 0, const char *desc = "")
+    {
+        return flag_option(name, short_name, desc);
+    }
+
+    template <class T>
+    constexpr value_option<T> opt(const char *name, char short_name = 0, const char *desc = "",
+                                  bool need = true, const T &def = T())
+    {
+        return value_option<T>(name, short_name, desc, need, def, default_reader<T>());
+    }
+
+    template <class T, class F>
+    constexpr value_option<T, F> opt(const char *name, char short_name, const char *desc,
+                                     bool need, const T &def, const F &reader)
+    {
+        return value_option<T, F>(name, short_name, desc, need, def, reader);
+    }
+
+    template <class... Opts>
+    class static_schema;
+
+    enum class static_error
+    {
+        none,
+        no_arguments,
+        undefined_option,
+        undefined_short_option,
+        option_needs_value,
+        invalid_value,
+        need_option
+    };
+
+    // typed result of static_schema::parse(). error() formats lazily and
+    // refers to argv, so it must be called while argv is alive.
+    template <class... Opts>
+    class static_result
+    {
+    public:
+        template <size_t I>
+        using type = typename std::tuple_element<I, std::tuple<Opts...> >::type::value_type;
+
+        static_result() = default;
+
+        template <size_t I>
+        const type<I> &get() const { return std::get<I>(values_); }
+
+        template <size_t I>
+        bool has() const { return set_[I]; }
+
+        bool ok() const { return error_ == static_error::none; }
+        static_error error_code() const { return error_; }
+        size_t error_count() const { return errors_; }
+        size_t rest_count() const { return rest_; }
+
+        std::string error() const
+        {
+            std::string text(text_, text_len_);
+            switch (error_)
+            {
+                case static_error::none: return "";
+                case static_error::no_arguments: return "argument number must be longer than 0";
+                case static_error::undefined_option: return "undefined option: --" + text;
+                case static_error::undefined_short_option: return "undefined short option: -" + text;
+                case static_error::option_needs_value: return "option needs value: --" + text;
+                case static_error::invalid_value: return "option value is invalid: --" + text + "=" + value_;
+                case static_error::need_option: return "need option: --" + text;
+            }
+            return "";
+        }
+
+    private:
+        friend class static_schema<Opts...>;
+
+        void fail(static_error e, const char *text, size_t len, const char *value = "")
+        {
+            if (errors_++ == 0) {
+                error_ = e;
+                text_ = text;
+                text_len_ = len;
+                value_ = value;
+            }
+        }
+
+        std::tuple<typename Opts::value_type...> values_;
+        std::bitset<sizeof...(Opts)> set_;
+        size_t rest_ = 0;
+
+        static_error error_ = static_error::none;
+        size_t errors_ = 0;
+        const char *text_ = "";
+        size_t text_len_ = 0;
+        const char *value_ = "";
+    };
+
+    template <class... Opts>
+    class static_schema
+    {
+    public:
+        typedef static_result<Opts...> result_type;
+
+        static constexpr size_t size() { return sizeof...(Opts); }
+
+        explicit static_schema(const Opts&... opts) : opts_(opts...)
+        {
+            build(detail::make_index_sequence<sizeof...(Opts)>());
+        }
+
+        template <size_t I>
+        const typename std::tuple_element<I, std::tuple<Opts...> >::type &option() const
+        {
+            return std::get<I>(opts_);
+        }
+
+        // index of the option called name, or -1
+        int find(const char *name, size_t len) const
+        {
+            auto it = std::lower_bound(by_name_.begin(), by_name_.end(), entry{name, len, 0}, less);
+            if (it == by_name_.end() || it->len != len || std::memcmp(it->name, name, len) != 0)
+                return -1;
+            return static_cast<int>(it->index);
+        }
+
+        int find(const char *name) const { return find(name, std::strlen(name)); }
+
+        result_type parse(int argc, const char * const argv[]) const
+        {
+            result_type r;
+            parse(argc, argv, r);
+            return r;
+        }
+
+        bool parse(int argc, const char * const argv[], result_type &r) const
+        {
+            return parse(argc, argv, r, [](const char *) {});
+        }
+
+        // positional arguments are passed to on_rest in order
+        template <class Sink>
+        bool parse(int argc, const char * const argv[], result_type &r, Sink on_rest) const
+        {
+            reset(r, detail::make_index_sequence<sizeof...(Opts)>());
+
+            if (argc < 1) {
+                r.fail(static_error::no_arguments, "", 0);
+                return false;
+            }
+
+            for (int i = 1; i < argc; i++)
+            {
+                const char *arg = argv[i];
+                if (arg[0] == '-' && arg[1] == '-')
+                {
+                    const char *name = arg + 2;
+                    const char *eq = std::strchr(name, '=');
+                    size_t len = eq ? static_cast<size_t>(eq - name) : std::strlen(name);
+                    int idx = find(name, len);
+                    if (idx < 0) {
+                        r.fail(static_error::undefined_option, name, len);
+                        continue;
+                    }
+                    if (eq) {
+                        if (!has_value(idx) || !setters()[idx](*this, r, eq + 1))
+                            r.fail(static_error::invalid_value, name, len, eq + 1);
+                    } else if (has_value(idx)) {
+                        if (i + 1 >= argc)
+                            r.fail(static_error::option_needs_value, name, len);
+                        else
+                            set(r, idx, argv[++i]);
+                    } else {
+                        setters()[idx](*this, r, nullptr);
+                    }
+                }
+                else if (arg[0] == '-')
+                {
+                    for (int j = 1; arg[j]; j++)
+                    {
+                        int idx = by_short_[static_cast<unsigned char>(arg[j])] - 1;
+                        if (idx < 0) {
+                            r.fail(static_error::undefined_short_option, arg + j, 1);
+                            continue;
+                        }
+                        if (!has_value(idx)) {
+                            setters()[idx](*this, r, nullptr);
+                        } else if (!arg[j + 1] && i + 1 < argc) {
+                            set(r, idx, argv[++i]);
+                        } else {
+                            r.fail(static_error::option_needs_value, names()[idx], std::strlen(names()[idx]));
+                        }
+                    }
+                }
+                else
+                {
+                    r.rest_++;
+                    on_rest(arg);
+                }
+            }
+
+            for (size_t i = 0; i < sizeof...(Opts); i++)
+                if (needs()[i] && !r.set_[i])
+                    r.fail(static_error::need_option, names()[i], std::strlen(names()[i]));
+
+            return r.ok();
+        }
+
+        std::string usage(const std::string &program_name) const
+        {
+            std::string descriptions[sizeof...(Opts) + 1];
+            std::string short_descriptions[sizeof...(Opts) + 1];
+            describe(descriptions, short_descriptions, detail::make_index_sequence<sizeof...(Opts)>());
+
+            std::ostringstream oss;
+            oss << "usage: " << program_name << " ";
+            for (size_t i = 0; i < sizeof...(Opts); i++)
+                if (needs()[i])
+                    oss << short_descriptions[i] << " ";
+            oss << "[options] ... " << std::endl;
+            oss << "options:" << std::endl;
+
+            size_t max_width = 0;
+            for (size_t i = 0; i < sizeof...(Opts); i++)
+                max_width = std::max(max_width, std::strlen(names()[i]));
+
+            for (size_t i = 0; i < sizeof...(Opts); i++)
+            {
+                char s = shorts()[i];
+                if (s)
+                    oss << "  -" << s << ", ";
+                else
+                    oss << "      ";
+                oss << "--" << names()[i];
+                oss << std::string(max_width + 4 - std::strlen(names()[i]), ' ');
+                oss << descriptions[i] << std::endl;
+            }
+            return oss.str();
+        }
+
+    private:
+        typedef bool (*setter)(const static_schema &, result_type &, const char *);
+
+        struct entry
+        {
+            const char *name;
+            size_t len;
+            size_t index;
+        };
+
+        static bool less(const entry &a, const entry &b)
+        {
+            int c = std::memcmp(a.name, b.name, std::min(a.len, b.len));
+            return c < 0 || (c == 0 && a.len < b.len);
+        }
+
+        // every table has a trailing sentinel so that an empty schema is valid
+        template <size_t... I>
+        static const setter *setters(detail::index_sequence<I...>)
+        {
+            static const setter table[] = { &static_schema::template set_option<I>..., nullptr };
+            return table;
+        }
+        static const setter *setters() { return setters(detail::make_index_sequence<sizeof...(Opts)>()); }
+
+        const char *const *names() const { return names_.data(); }
+        const char *shorts() const { return shorts_.data(); }
+        const bool *needs() const { return needs_.data(); }
+
+        static bool has_value(int idx)
+        {
+            static const bool table[] = { Opts::has_value..., false };
+            return table[idx];
+        }
+
+        template <size_t... I>
+        void build(detail::index_sequence<I...>)
+        {
+            names_ = {{ std::get<I>(opts_).name..., nullptr }};
+            shorts_ = {{ std::get<I>(opts_).short_name..., '\0' }};
+            needs_ = {{ need_of(std::get<I>(opts_))..., false }};
+
+            by_short_.fill(0);
+            for (size_t i = 0; i < sizeof...(Opts); i++)
+            {
+                by_name_[i] = entry{names_[i], std::strlen(names_[i]), i};
+
+                unsigned char s = static_cast<unsigned char>(shorts_[i]);
+                if (!s)
+                    continue;
+                if (by_short_[s])
+                    throw cmdline_error(std::string("short option '") + shorts_[i] + "' is ambiguous");
+                by_short_[s] = static_cast<unsigned short>(i + 1);
+            }
+
+            std::sort(by_name_.begin(), by_name_.end(), less);
+            for (size_t i = 1; i < sizeof...(Opts); i++)
+                if (!less(by_name_[i - 1], by_name_[i]))
+                    throw cmdline_error("multiple definition: " + std::string(by_name_[i].name));
+        }
+
+        template <size_t... I>
+        void reset(result_type &r, detail::index_sequence<I...>) const
+        {
+            int dummy[] = { (std::get<I>(r.values_) = default_of(std::get<I>(opts_)), 0)..., 0 };
+            (void)dummy;
+            r.set_.reset();
+            r.rest_ = 0;
+            r.error_ = static_error::none;
+            r.errors_ = 0;
+        }
+
+        template <size_t... I>
+        void describe(std::string *descriptions, std::string *short_descriptions,
+                      detail::index_sequence<I...>) const
+        {
+            int dummy[] = { (descriptions[I] = description_of(std::get<I>(opts_)),
+                             short_descriptions[I] = "--" + std::string(names_[I]) + "=" +
+                                                     type_name_of(std::get<I>(opts_)), 0)..., 0 };
+            (void)dummy;
+        }
+
+        void set(result_type &r, int idx, const char *value) const
+        {
+            if (!setters()[idx](*this, r, value))
+                r.fail(static_error::invalid_value, names()[idx], std::strlen(names()[idx]), value);
+        }
+
+        template <size_t I>
+        static bool set_option(const static_schema &self, result_type &r, const char *value)
+        {
+            if (!assign(std::get<I>(self.opts_), std::get<I>(r.values_), value))
+                return false;
+            r.set_.set(I);
+            return true;
+        }
+
+        static bool assign(const flag_option &, bool &out, const char *value)
+        {
+            if (value)
+                return false;
+            out = true;
+            return true;
+        }
+
+        template <class T, class F>
+        static bool assign(const value_option<T, F> &o, T &out, const char *value)
+        {
+            if (!value)
+                return false;
+            return detail::read_with(o.reader, string_ref(value), out);
+        }
+
+        static bool default_of(const flag_option &) { return false; }
+        template <class T, class F>
+        static const T &default_of(const value_option<T, F> &o) { return o.def; }
+
+        static bool need_of(const flag_option &) { return false; }
+        template <class T, class F>
+        static bool need_of(const value_option<T, F> &o) { return o.need; }
+
+        static std::string type_name_of(const flag_option &) { return ""; }
+        template <class T, class F>
+        static std::string type_name_of(const value_option<T, F> &) { return detail::type_name<T>::get(); }
+
+        static std::string description_of(const flag_option &o) { return o.desc; }
+        template <class T, class F>
+        static std::string description_of(const value_option<T, F> &o)
+        {
+            return o.desc + std::string(" (") + detail::type_name<T>::get() +
+                   (o.need ? "" : " [=" + detail::default_text(o.reader, o.def) + "]") + ")";
+        }
+
+        std::tuple<Opts...> opts_;
+        std::array<const char *, sizeof...(Opts) + 1> names_;
+        std::array<char, sizeof...(Opts) + 1> shorts_;
+        std::array<bool, sizeof...(Opts) + 1> needs_;
+        std::array<entry, sizeof...(Opts)> by_name_;
+        std::array<unsigned short, 256> by_short_;
+    };
+
+    template <class... Opts>
+    static_schema<Opts...> make_schema(const Opts&... opts)
+    {
+        return static_schema<Opts...>(opts...);
+    }
+}
@@ -0,0 +1,119 @@
+/*
+  Copyright (c) 2009-2019, Hideyuki Tanaka, Joel
+  All rights reserved.
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+  * Neither the name of the <organization> nor the
+  names of its contributors may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+  THIS SOFTWARE IS PROVIDED BY <copyright holder> ''AS IS'' AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <ostream>
+#include <string>
+
+#include <cstring>
+
+namespace cmdline
+{
+    // non-owning view of a character range, a C++11 stand-in for
+    // std::string_view. it never allocates; converting to std::string is
+    // explicit so that copies are always visible.
+    class string_ref
+    {
+    public:
+        typedef const char *const_iterator;
+        static const size_t npos = static_cast<size_t>(-1);
+
+        constexpr string_ref() : data_(""), size_(0) {}
+        constexpr string_ref(const char *data, size_t size) : data_(data), size_(size) {}
+        string_ref(const char *s) : data_(s), size_(std::strlen(s)) {}
+        string_ref(const std::string &s) : data_(s.data()), size_(s.size()) {}
+
+        constexpr const char *data() const { return data_; }
+        constexpr size_t size() const { return size_; }
+        constexpr bool empty() const { return size_ == 0; }
+        constexpr const_iterator begin() const { return data_; }
+        constexpr const_iterator end() const { return data_ + size_; }
+        constexpr char operator[](size_t i) const { return data_[i]; }
+
+        string_ref substr(size_t pos, size_t n = npos) const
+        {
+            pos = std::min(pos, size_);
+            return string_ref(data_ + pos, std::min(n, size_ - pos));
+        }
+
+        size_t find(char c, size_t pos = 0) const
+        {
+            if (pos >= size_)
+                return npos;
+            const void *p = std::memchr(data_ + pos, c, size_ - pos);
+            return p ? static_cast<size_t>(static_cast<const char*>(p) - data_) : npos;
+        }
+
+        size_t rfind(char c) const
+        {
+            for (size_t i = size_; i > 0; i--)
+            {
+                if (data_[i - 1] == c)
+                    return i - 1;
+            }
+            return npos;
+        }
+
+        bool starts_with(string_ref prefix) const
+        {
+            return size_ >= prefix.size_ && std::memcmp(data_, prefix.data_, prefix.size_) == 0;
+        }
+
+        int compare(string_ref other) const
+        {
+            int c = std::memcmp(data_, other.data_, std::min(size_, other.size_));
+            if (c != 0)
+                return c;
+            return size_ < other.size_ ? -1 : (size_ > other.size_ ? 1 : 0);
+        }
+
+        explicit operator std::string() const { return std::string(data_, size_); }
+
+    private:
+        const char *data_;
+        size_t size_;
+    };
+
+    inline bool operator==(string_ref a, string_ref b)
+    {
+        return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()) == 0;
+    }
+    inline bool operator!=(string_ref a, string_ref b) { return !(a == b); }
+    inline bool operator<(string_ref a, string_ref b) { return a.compare(b) < 0; }
+
+    inline std::string operator+(const std::string &a, string_ref b)
+    {
+        std::string ret(a);
+        ret.append(b.data(), b.size());
+        return ret;
+    }
+
+    inline std::ostream &operator<<(std::ostream &os, string_ref s)
+    {
+        return os.write(s.data(), static_cast<std::streamsize>(s.size()));
+    }
+}
@@ -0,0 +1,176 @@
+/*
+  Copyright (c) 2009-2019, Hideyuki Tanaka, Joel
+  All rights reserved.
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+  * Neither the name of the <organization> nor the
+  names of its contributors may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+  THIS SOFTWARE IS PROVIDED BY <copyright holder> ''AS IS'' AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+#include "string_ref.hpp"
+
+namespace cmdline { namespace detail {
+    // edit distance from one pattern to many texts, with the bit-parallel
+    // algorithm of Myers in Hyyro's form for whole strings: a column of the
+    // distance table is kept as two 64 bit masks of +1 and -1 steps, so a
+    // text costs a handful of operations per character. patterns longer
+    // than 64 characters are never close to anything.
+    class edit_distance
+    {
+    public:
+        explicit edit_distance(string_ref pattern) : size_(pattern.size())
+        {
+            if (size_ > max_size)
+                return;
+            for (size_t i = 0; i < size_; i++)
+                peq_[static_cast<unsigned char>(pattern[i])] |= uint64_t(1) << i;
+            chars_ = char_set(pattern);
+        }
+
+        // distance to text, or bound + 1 if it is more than bound
+        size_t operator()(string_ref text, size_t bound) const
+        {
+            const size_t m = size_;
+            const size_t n = text.size();
+            if (m > max_size || (m > n ? m - n : n - m) > bound)
+                return bound + 1;
+            if (m == 0 || n == 0)
+                return m + n;
+
+            // every character of one that the other lacks costs an edit
+            uint64_t chars = char_set(text);
+            if (popcount(chars_ & ~chars) > bound || popcount(chars & ~chars_) > bound)
+                return bound + 1;
+
+            // the distance is the last cell of the diagonal through the
+            // end, and cells never decrease along a diagonal: follow it and
+            // give up as soon as it passes bound. diag is its cell in the
+            // previous column, row the mask of that cell's row.
+            const size_t start = n > m ? n - m : 0;
+            size_t diag = m > n ? m - n : n - m;
+            uint64_t row = uint64_t(1) << (m > n ? m - n : 0);
+
+            uint64_t pv = ~uint64_t(0);
+            uint64_t mv = 0;
+            for (size_t j = 0; j < n; j++)
+            {
+                uint64_t eq = peq_[static_cast<unsigned char>(text[j])];
+                uint64_t xv = eq | mv;
+                uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+                uint64_t ph = (mv | ~(xh | pv)) << 1 | 1;
+                uint64_t mh = (pv & xh) << 1;
+                pv = mh | ~(xv | ph);
+                mv = ph & xv;
+
+                if (j >= start) {
+                    // one step right on the diagonal's row, one step down
+                    diag += ((ph & row) != 0) + ((pv & row) != 0);
+                    diag -= ((mh & row) != 0) + ((mv & row) != 0);
+                    if (diag > bound)
+                        return bound + 1;
+                    row <<= 1;
+                }
+            }
+            return diag;
+        }
+
+    private:
+        static const size_t max_size = 64;
+
+        // the characters of s, folded into 64 bits. folding only merges
+        // characters, so the lower bound above stays a lower bound.
+        static uint64_t char_set(string_ref s)
+        {
+            uint64_t set = 0;
+            for (char c : s)
+                set |= uint64_t(1) << (static_cast<unsigned char>(c) & 63);
+            return set;
+        }
+
+        static size_t popcount(uint64_t x)
+        {
+#if defined(__GNUC__)
+            return static_cast<size_t>(__builtin_popcountll(x));
+#else
+            x = x - ((x >> 1) & 0x5555555555555555ull);
+            x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+            x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+            return static_cast<size_t>((x * 0x0101010101010101ull) >> 56);
+#endif
+        }
+
+        uint64_t peq_[256] = {};
+        uint64_t chars_ = 0;
+        size_t size_;
+    };
+
+    // the names closest to a mistyped one, for "did you mean". a name is
+    // close if a quarter of its characters (and one more) can be edited to
+    // get it; each closer name tightens the bound for the next ones.
+    class suggestions
+    {
+    public:
+        explicit suggestions(string_ref typo) : distance_(typo), bound_(1 + typo.size() / 4) {}
+
+        void offer(string_ref name)
+        {
+            size_t d = distance_(name, bound_);
+            if (d > bound_)
+                return;
+            if (d < bound_) {
+                best_.clear();
+                bound_ = d;
+            }
+            if (best_.size() < max_count)
+                best_.push_back(name);
+        }
+
+        // names further than this are not offered anything
+        size_t bound() const { return bound_; }
+
+        // " (did you mean --a or --b?)", or "" if nothing was close
+        std::string text(string_ref prefix) const
+        {
+            std::string ret;
+            for (size_t i = 0; i < best_.size(); i++)
+            {
+                ret += i == 0 ? " (did you mean " : (i + 1 == best_.size() ? " or " : ", ");
+                ret.append(prefix.data(), prefix.size());
+                ret.append(best_[i].data(), best_[i].size());
+            }
+            if (!ret.empty())
+                ret += "?)";
+            return ret;
+        }
+
+    private:
+        static const size_t max_count = 3;
+
+        edit_distance distance_;
+        size_t bound_;
+        std::vector<string_ref> best_;
+    };
+} }
@@ -0,0 +1,268 @@
+/*
+  Copyright (c) 2009-2019, Hideyuki Tanaka, Joel
+  All rights reserved.
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+  * Neither the name of the <organization> nor the
+  names of its contributors may be used to endorse or promote products
+  derived from this software without specific prior written permission.
+  THIS SOFTWARE IS PROVIDED BY <copyright holder> ''AS IS'' AND ANY
+  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CMDLINE_TOKENIZER_SSE2 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#include "string_ref.hpp"
+
+namespace cmdline { namespace detail {
+    // splits a buffer into arguments, one at a time, with shell-like rules:
+    // unquoted blanks separate arguments and runs of them count as one,
+    // '...' quotes everything up to the next ', "..." quotes everything but
+    // \" \\ \$ and \`, and outside of quotes '\' escapes the next character.
+    //
+    // in string mode spaces and tabs are blanks. in file mode (response
+    // files) any whitespace is.
+    //
+    // arguments without quotes or escapes are views into the buffer. the
+    // others are unescaped in place if the tokenizer was given a writable
+    // buffer, and into a scratch string that is overwritten by the next
+    // call otherwise; escaped() tells whether the scratch string was used.
+    class tokenizer
+    {
+    public:
+        tokenizer(string_ref buf, bool file_mode)
+                : p_(buf.begin()), last_(buf.end()), out_(nullptr), file_mode_(file_mode) {}
+
+        // unescapes into buf itself
+        tokenizer(char *first, char *last, bool file_mode)
+                : p_(first), last_(last), out_(first), file_mode_(file_mode) {}
+
+        bool next(string_ref &token)
+        {
+            if (error_)
+                return false;
+
+            while (p_ != last_ && is_blank(*p_))
+                ++p_;
+            if (p_ == last_)
+                return false;
+
+            const char *start = p_;
+            p_ = find_special(p_, last_);
+
+            if (p_ == last_ || is_blank(*p_)) {
+                token = string_ref(start, static_cast<size_t>(p_ - start));
+                escaped_ = false;
+                return true;
+            }
+
+            // quotes or escapes: copy what was scanned and unescape the rest.
+            // the scratch string grows with the token, not with the buffer.
+            if (out_) {
+                w_ = out_ + (p_ - out_);
+            } else {
+                scratch_.clear();
+                scratch_.append(start, static_cast<size_t>(p_ - start));
+            }
+
+            while (p_ != last_ && !is_blank(*p_))
+            {
+                const char *q = find_special(p_, last_);
+                emit(p_, static_cast<size_t>(q - p_));
+                p_ = q;
+                if (p_ == last_ || is_blank(*p_))
+                    break;
+
+                char c = *p_++;
+                if (c == '\\') {
+                    if (p_ == last_) {
+                        error_ = "unexpected occurrence of '\\' at end of string";
+                        return false;
+                    }
+                    emit(*p_++);
+                } else if (c == '\'') {
+                    const char *close = static_cast<const char*>(std::memchr(p_, '\'', static_cast<size_t>(last_ - p_)));
+                    if (!close) {
+                        error_ = "quote is not closed";
+                        return false;
+                    }
+                    emit(p_, static_cast<size_t>(close - p_));
+                    p_ = close + 1;
+                } else {
+                    if (!double_quoted())
+                        return false;
+                }
+            }
+
+            if (out_) {
+                char *out = out_ + (start - out_);
+                token = string_ref(out, static_cast<size_t>(w_ - out));
+            } else {
+                token = string_ref(scratch_);
+            }
+            escaped_ = !out_;
+            return true;
+        }
+
+        bool escaped() const { return escaped_; }
+        const char *error() const { return error_; }
+
+    private:
+        // unescaped text goes to the buffer itself, behind the read position,
+        // or to the scratch string
+        void emit(const char *p, size_t n)
+        {
+            if (out_) {
+                std::memmove(w_, p, n);
+                w_ += n;
+            } else {
+                scratch_.append(p, n);
+            }
+        }
+
+        void emit(char c)
+        {
+            if (out_)
+                *w_++ = c;
+            else
+                scratch_ += c;
+        }
+
+        // body of "..." after the opening quote
+        bool double_quoted()
+        {
+            for (;;)
+            {
+                const char *q = p_;
+                while (q != last_ && *q != '"' && *q != '\\')
+                    ++q;
+                emit(p_, static_cast<size_t>(q - p_));
+                p_ = q;
+                if (p_ == last_) {
+                    error_ = "quote is not closed";
+                    return false;
+                }
+                if (*p_++ == '"')
+                    return true;
+
+                if (p_ == last_) {
+                    error_ = "quote is not closed";
+                    return false;
+                }
+                char c = *p_;
+                if (c == '"' || c == '\\' || c == '$' || c == '`')
+                    ++p_;
+                else
+                    c = '\\';
+                emit(c);
+            }
+        }
+
+        bool is_blank(char c) const
+        {
+            return c == ' ' || c == '\t' ||
+                   (file_mode_ && (c == '\n' || c == '\r' || c == '\f' || c == '\v'));
+        }
+
+        static bool is_quote_or_escape(char c) { return c == '"' || c == '\'' || c == '\\'; }
+
+        // first blank, quote or backslash in [p, last)
+        const char *find_special(const char *p, const char *last) const
+        {
+#if defined(CMDLINE_TOKENIZER_SSE2)
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i tab = _mm_set1_epi8('\t');
+            const __m128i dquote = _mm_set1_epi8('"');
+            const __m128i squote = _mm_set1_epi8('\'');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            // \t to \r are 9 to 13: bias them to the bottom of the signed range
+            const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80 - 9));
+            const __m128i ws_top = _mm_set1_epi8(static_cast<char>(-128 + 5));
+            for (; last - p >= 16; p += 16)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, dquote)),
+                                         _mm_or_si128(_mm_cmpeq_epi8(v, squote), _mm_cmpeq_epi8(v, backslash)));
+                if (file_mode_)
+                    m = _mm_or_si128(m, _mm_cmplt_epi8(_mm_add_epi8(v, bias), ws_top));
+                else
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, tab));
+                int mask = _mm_movemask_epi8(m);
+                if (mask)
+                    return p + count_trailing_zeros(static_cast<unsigned>(mask));
+            }
+#else
+            // eight bytes at a time: a byte of x is zero where p matches
+            for (; last - p >= 8; p += 8)
+            {
+                uint64_t v;
+                std::memcpy(&v, p, 8);
+                uint64_t hit = has_byte(v, ' ') | has_byte(v, '\t') | has_byte(v, '"') |
+                               has_byte(v, '\'') | has_byte(v, '\\');
+                if (file_mode_)
+                    hit |= has_byte(v, '\n') | has_byte(v, '\r') | has_byte(v, '\f') | has_byte(v, '\v');
+                if (hit)
+                    break;
+            }
+#endif
+            while (p != last && !is_blank(*p) && !is_quote_or_escape(*p))
+                ++p;
+            return p;
+        }
+
+#if defined(CMDLINE_TOKENIZER_SSE2)
+        static unsigned count_trailing_zeros(unsigned x)
+        {
+#if defined(_MSC_VER)
+            unsigned long i;
+            _BitScanForward(&i, x);
+            return i;
+#else
+            return static_cast<unsigned>(__builtin_ctz(x));
+#endif
+        }
+#else
+        static uint64_t has_byte(uint64_t v, unsigned char c)
+        {
+            uint64_t x = v ^ (0x0101010101010101ull * c);
+            return (x - 0x0101010101010101ull) & ~x & 0x8080808080808080ull;
+        }
+#endif
+
+        const char *p_;
+        const char *last_;
+        char *out_;
+        // write position of in place unescaping
+        char *w_ = nullptr;
+        bool file_mode_;
+        bool escaped_ = false;
+        const char *error_ = nullptr;
+        std::string scratch_;
+    };
+} }